@@ -0,0 +1,120 @@
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include "hashmap.h"
+#include "chashmap.h"
+
+#define KEYS (1 << 16)
+#define OPS_PER_THREAD 2000000
+#define WRITE_PERCENT 5
+
+/* keys are small integers disguised as pointers, never dereferenced */
+#define KEY(i) ((void*)(size_t)((i) + 1))
+
+chashmap_ds *cmap = NULL;
+hashmap_ds *map = NULL;
+pthread_mutex_t map_lock = PTHREAD_MUTEX_INITIALIZER;
+
+size_t key_hash(const void *key) {
+	size_t value = (size_t)key;
+	value ^= value >> 16;
+	value *= 0x45d9f3bu;
+	value ^= value >> 16;
+	return value;
+}
+
+int key_equals(const void *a, const void *b) {
+	return a == b;
+}
+
+typedef struct bench_worker {
+	pthread_t thread;
+	unsigned seed;
+	size_t found;
+} bench_worker;
+
+/* xorshift, so that threads don't serialize on rand()'s internal state */
+unsigned next_random(unsigned *seed) {
+	*seed ^= *seed << 13;
+	*seed ^= *seed >> 17;
+	*seed ^= *seed << 5;
+	return *seed;
+}
+
+void *run_chashmap(void *arg) {
+	bench_worker *worker = arg;
+	size_t i;
+	for (i = 0; i < OPS_PER_THREAD; i++) {
+		unsigned r = next_random(&worker->seed);
+		if (r % 100 < WRITE_PERCENT) {
+			chashmap_put(cmap, KEY(r % KEYS), KEY(r));
+		} else if (chashmap_get(cmap, KEY(r % KEYS)) != NULL) {
+			worker->found++;
+		}
+	}
+	return NULL;
+}
+
+void *run_locked_hashmap(void *arg) {
+	bench_worker *worker = arg;
+	size_t i;
+	for (i = 0; i < OPS_PER_THREAD; i++) {
+		unsigned r = next_random(&worker->seed);
+		pthread_mutex_lock(&map_lock);
+		if (r % 100 < WRITE_PERCENT) {
+			hashmap_put(map, KEY(r % KEYS), KEY(r));
+		} else if (hashmap_get(map, KEY(r % KEYS)) != NULL) {
+			worker->found++;
+		}
+		pthread_mutex_unlock(&map_lock);
+	}
+	return NULL;
+}
+
+double run_threads(void *run(void*), int threads) {
+	int i;
+	struct timespec start, end;
+	bench_worker *workers = malloc(threads * sizeof *workers);
+	
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < threads; i++) {
+		workers[i].seed = 2463534242u + i;
+		workers[i].found = 0;
+		pthread_create(&workers[i].thread, NULL, run, &workers[i]);
+	}
+	for (i = 0; i < threads; i++) {
+		pthread_join(workers[i].thread, NULL);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	free(workers);
+	
+	/* millions of operations per second */
+	return threads * (double)OPS_PER_THREAD / ((end.tv_sec - start.tv_sec) * 1e6 + (end.tv_nsec - start.tv_nsec) / 1e3);
+}
+
+int main(int argc, char **argv) {
+	int i, threads, max_threads = argc > 1 ? atoi(argv[1]) : 8;
+	
+	cmap = alloc_chashmap(key_hash, key_equals, 0);
+	map = alloc_hashmap64(key_hash, key_equals, HASHMAP_ROBINHOOD);
+	for (i = 0; i < KEYS; i++) {
+		chashmap_put(cmap, KEY(i), KEY(i));
+		hashmap_put(map, KEY(i), KEY(i));
+	}
+	
+	printf("=== BENCHMARKING CONCURRENT HASHMAP === \n");
+	printf("%d keys, %d%% writes, %d operations per thread\n", KEYS, WRITE_PERCENT, OPS_PER_THREAD);
+	printf("threads\tchashmap (Mops/s)\thashmap + mutex (Mops/s)\n");
+	for (threads = 1; threads <= max_threads; threads <<= 1) {
+		double concurrent = run_threads(run_chashmap, threads);
+		double locked = run_threads(run_locked_hashmap, threads);
+		printf("%d\t%.2f\t\t\t%.2f\n", threads, concurrent, locked);
+	}
+	printf("=== BENCHMARKING DONE  === \n");
+	
+	dealloc_chashmap(cmap);
+	dealloc_hashmap(map);
+	return 0;
+}
@@ -0,0 +1,76 @@
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "deque.h"
+#include "deque_typed.h"
+
+#define EVENTS (1 << 20)
+#define ROUNDS 8
+
+/* a 16-byte event record, as queued by value or behind a pointer */
+typedef struct event {
+	size_t timestamp;
+	unsigned kind;
+	unsigned payload;
+} event;
+
+DEFINE_DEQUE(eventdeque, event)
+
+double elapsed(struct timespec *start) {
+	struct timespec end;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+int main(void) {
+	size_t i, round, checksum = 0, typed_checksum = 0;
+	double pointer_seconds, typed_seconds;
+	struct timespec start;
+	deque_ds *deque = alloc_deque();
+	eventdeque *typed = eventdeque_alloc();
+	
+	printf("=== BENCHMARKING TYPED DEQUE === \n");
+	printf("%d rounds of enqueuing then dequeuing %d events of %d bytes\n", ROUNDS, EVENTS, (int)sizeof(event));
+	
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (round = 0; round < ROUNDS; round++) {
+		for (i = 0; i < EVENTS; i++) {
+			event *ev = malloc(sizeof *ev);
+			ev->timestamp = i;
+			ev->kind = (unsigned)round;
+			ev->payload = (unsigned)i;
+			deque_enqueue(deque, ev);
+		}
+		while (!deque_isempty(deque)) {
+			event *ev = deque_dequeue(deque);
+			checksum += ev->timestamp + ev->payload;
+			free(ev);
+		}
+	}
+	pointer_seconds = elapsed(&start);
+	
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (round = 0; round < ROUNDS; round++) {
+		event ev;
+		for (i = 0; i < EVENTS; i++) {
+			ev.timestamp = i;
+			ev.kind = (unsigned)round;
+			ev.payload = (unsigned)i;
+			eventdeque_pushright(typed, ev);
+		}
+		while (eventdeque_popleft(typed, &ev)) {
+			typed_checksum += ev.timestamp + ev.payload;
+		}
+	}
+	typed_seconds = elapsed(&start);
+	
+	if (checksum != typed_checksum) printf("checksums differ!\n");
+	printf("deque of malloc'd events:\t%.2f Mevents/s\n", ROUNDS * (EVENTS / 1e6) / pointer_seconds);
+	printf("typed deque of events:\t\t%.2f Mevents/s\n", ROUNDS * (EVENTS / 1e6) / typed_seconds);
+	printf("=== BENCHMARKING DONE  === \n");
+	
+	dealloc_deque(deque);
+	eventdeque_dealloc(typed);
+	return 0;
+}
@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <time.h>
 #include "hashmap.h"
+#include "hashset.h"
 #include "pqueue.h"
 #include "graph.h"
 #include "deque.h"
@@ -9,6 +10,7 @@
 char letters_array[26];
 char *alphabet = letters_array - 'A';
 hashmap_ds *map = NULL;
+hashset_ds *set = NULL;
 pqueue_ds *pqueue = NULL;
 graph_ds *graph = NULL;
 deque_ds *deque = NULL;
@@ -29,6 +31,7 @@ int char_hash(const void *c) {
 
 void test_deque(void);
 void test_hashmap(void);
+void test_hashset(void);
 void test_pqueue(void);
 void test_graph(void);
 
@@ -41,6 +44,7 @@ void test_graph(void);
 #define alloc_ds() \
 	do { \
 		map = alloc_hashmap(char_hash, char_equals); \
+		set = alloc_hashset(char_hash, char_equals); \
 		pqueue = alloc_pqueue(char_comparator); \
 		graph = alloc_graph(char_hash, char_equals); \
 		deque = alloc_deque(); \
@@ -49,6 +53,7 @@ void test_graph(void);
 #define free_ds() \
 	do { \
 		dealloc_hashmap(map); map = NULL; \
+		dealloc_hashset(set); set = NULL; \
 		dealloc_pqueue(pqueue); pqueue = NULL; \
 		dealloc_graph(graph); graph = NULL; \
 		dealloc_deque(deque); deque = NULL; \
@@ -60,6 +65,7 @@ int main(void) {
 	alloc_ds();
 	test_deque();
 	test_hashmap();
+	test_hashset();
 	test_pqueue();
 	test_graph();
 	free_ds();
@@ -101,8 +107,13 @@ void test_deque(void) {
 void test_hashmap(void) {
 	int i;
 	char strings[][14] = {"mapped from A", "mapped from B", "mapped from C", "mapped from X", "mapped from Y", "mapped from Z"};
+	hashmap_stats stats;
+	hashmap_ds *numbers;
+	hashmap_snapshot_ds *before, *after;
+	size_t n;
 	
 	printf("=== TESTING HASHMAP === \n");
+	hashmap_set_stats(map, 1);
 	
 	/* Putting into hashmap */
 	for (i = 'A'; i <= 'C'; i++) {
@@ -128,6 +139,73 @@ void test_hashmap(void) {
 	hashmap_remove(map, &alphabet['A']);
 	printf("Removed the key 'A'\n");
 	printf("Attempting to get with the removed key: [%s]\n", (char*)hashmap_get(map, &alphabet['A']));
+	
+	/* Instrumentation */
+	hashmap_getstats(map, &stats);
+	printf("\nmax probe sequence length: %lu, probes per hit: %.2f, probes per miss: %.2f\n",
+		(unsigned long)stats.max_psl, stats.probes_per_hit, stats.probes_per_miss);
+	printf("hash calls: %lu, equality calls: %lu, rehashes: %lu\n",
+		(unsigned long)stats.hash_calls, (unsigned long)stats.equality_calls, (unsigned long)stats.rehashes);
+	hashmap_set_stats(map, 0);
+	
+	/* Snapshots taken before and after the hashmap grows, then every key is overwritten */
+	numbers = alloc_identityhashmap();
+	for (n = 1; n <= 100; n++) hashmap_put(numbers, (void*)n, (void*)n);
+	before = hashmap_snapshot(numbers);
+	for (n = 101; n <= 5000; n++) hashmap_put(numbers, (void*)n, (void*)n);
+	after = hashmap_snapshot(numbers);
+	for (n = 1; n <= 5000; n++) hashmap_put(numbers, (void*)n, (void*)(n * 2));
+	dealloc_hashmap(numbers);
+	printf("\nsnapshot before growing: %lu keys, 100 -> %lu\n",
+		(unsigned long)hashmap_snapshot_size(before), (unsigned long)hashmap_snapshot_get(before, (void*)(size_t)100));
+	printf("snapshot after growing: %lu keys, 5000 -> %lu\n",
+		(unsigned long)hashmap_snapshot_size(after), (unsigned long)hashmap_snapshot_get(after, (void*)(size_t)5000));
+	hashmap_snapshot_release(before);
+	hashmap_snapshot_release(after);
+	printf("=== TESTING DONE  === \n\n");
+}
+
+void print_hashset(const char *name, hashset_ds *const set) {
+	size_t i;
+	void **keys = hashset_getkeys(set);
+	printf("%s (%lu keys):", name, (unsigned long)hashset_size(set));
+	for (i = 0; keys[i] != NULL; i++) {
+		printf(" %c", *(char*)keys[i]);
+	}
+	printf("\n");
+	free(keys);
+}
+
+void test_hashset(void) {
+	int i;
+	const char *vowels = "AEIOU";
+	hashset_ds *other = alloc_hashset(char_hash, char_equals);
+	
+	printf("=== TESTING HASHSET === \n");
+	
+	/* Adding to the hashsets */
+	for (i = 'A'; i <= 'J'; i++) {
+		hashset_add(set, &alphabet[i]);
+	}
+	for (i = 0; vowels[i] != '\0'; i++) {
+		hashset_add(other, &alphabet[(int)vowels[i]]);
+	}
+	print_hashset("A to J", set);
+	print_hashset("vowels", other);
+	printf("contains 'E': %d, contains 'K': %d\n", hashset_contains(set, &alphabet['E']), hashset_contains(set, &alphabet['K']));
+	
+	/* Bulk operations */
+	hashset_difference(set, other);
+	print_hashset("A to J without vowels", set);
+	hashset_union(set, other);
+	print_hashset("...with all vowels again", set);
+	hashset_intersection(set, other);
+	print_hashset("...with vowels only", set);
+	
+	hashset_remove(set, &alphabet['A']);
+	printf("Removed the key 'A', contains 'A': %d\n", hashset_contains(set, &alphabet['A']));
+	
+	dealloc_hashset(other);
 	printf("=== TESTING DONE  === \n\n");
 }
 
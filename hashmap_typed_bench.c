@@ -0,0 +1,73 @@
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "hashmap.h"
+#include "hashmap_typed.h"
+
+#define KEYS (1 << 20)
+#define ROUNDS 8
+
+DEFINE_HASHMAP(sizemap, size_t, size_t, HASHMAP_TYPED_INT_HASH, HASHMAP_TYPED_EQUALS)
+
+/* keys are small integers disguised as pointers, never dereferenced */
+#define KEY(i) ((void*)(size_t)((i) + 1))
+
+size_t key_hash(const void *key) {
+	return hashmap_typed_int_hash((size_t)key);
+}
+
+int key_equals(const void *a, const void *b) {
+	return a == b;
+}
+
+double elapsed(struct timespec *start) {
+	struct timespec end;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+int main(void) {
+	size_t i, round, found = 0;
+	double put_seconds, get_seconds;
+	struct timespec start;
+	hashmap_ds *map = alloc_hashmap64(key_hash, key_equals, HASHMAP_ROBINHOOD);
+	sizemap *typed = sizemap_alloc();
+	
+	printf("=== BENCHMARKING TYPED HASHMAP === \n");
+	printf("%d integer keys, %d rounds of gets\n", KEYS, ROUNDS);
+	printf("\t\tput (Mops/s)\tget (Mops/s)\n");
+	
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < KEYS; i++) {
+		hashmap_put(map, KEY(i), KEY(i));
+	}
+	put_seconds = elapsed(&start);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (round = 0; round < ROUNDS; round++) {
+		for (i = 0; i < KEYS; i++) {
+			found += hashmap_get(map, KEY(i * 2)) != NULL;
+		}
+	}
+	get_seconds = elapsed(&start);
+	printf("hashmap\t\t%.2f\t\t%.2f\n", KEYS / put_seconds / 1e6, KEYS * (double)ROUNDS / get_seconds / 1e6);
+	
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < KEYS; i++) {
+		sizemap_put(typed, i + 1, i + 1, NULL);
+	}
+	put_seconds = elapsed(&start);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (round = 0; round < ROUNDS; round++) {
+		for (i = 0; i < KEYS; i++) {
+			found += sizemap_get(typed, i * 2 + 1) != NULL;
+		}
+	}
+	get_seconds = elapsed(&start);
+	printf("typed hashmap\t%.2f\t\t%.2f\n", KEYS / put_seconds / 1e6, KEYS * (double)ROUNDS / get_seconds / 1e6);
+	printf("=== BENCHMARKING DONE  === (%lu hits)\n", (unsigned long)found);
+	
+	dealloc_hashmap(map);
+	sizemap_dealloc(typed);
+	return 0;
+}
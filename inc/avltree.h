@@ -1,6 +1,8 @@
 #ifndef AVLTREE_H
 #define AVLTREE_H
 
+#include "ds_allocator.h"
+
 /**
  * Forward declaration of the avltree data structure. Internally implemented with a nested struct pointer
  * (node containg the value and its left and right children). In addition, the node contains a height variable
@@ -22,6 +24,16 @@ typedef struct avltree_ds_iterator avltree_ds_iterator;
  */
 avltree_ds *alloc_avltree(int comparator(const void*, const void*));
 
+/**
+ * Allocates an avltree instance with the given comparator function, obtaining the tree and all of its
+ * nodes from the given allocator. Nodes are all the same size, which makes them a good fit for a pool.
+ *
+ * @param[in] comparator function that compares values
+ * @param[in] allocator allocator of the avltree's memory (NULL for ds_default_allocator)
+ * @return instance of the avltree
+ */
+avltree_ds *alloc_avltree_with(int comparator(const void*, const void*), const ds_allocator *allocator);
+
 /**
  * Deallocates an avltree.
  *
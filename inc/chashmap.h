@@ -0,0 +1,71 @@
+#ifndef CHASHMAP_H
+#define CHASHMAP_H
+
+/**
+ * Forward declaration of the concurrent hashmap data structure. Internally implemented as an array of
+ * segments, each one a robin-hood table of inline entries guarded by its own lock and sequence counter.
+ * Writers lock the one segment the key hashes to, while readers never lock at all: they search the
+ * segment optimistically and retry if a writer modified it in the meantime (seqlock style). Tables that
+ * are outgrown stay allocated until the hashmap is deallocated, so a reader can always finish its search.
+ *
+ * Since readers may still be looking at a key or value after it was removed, keys and values removed from
+ * a chashmap must not be freed while other threads may be reading from it.
+ */
+typedef struct chashmap_ds chashmap_ds;
+
+/**
+ * Allocates a concurrent hashmap instance with given hash/equality functions. Both may be called from
+ * several threads at once, and a reader may call is_equals on a key that is being removed concurrently.
+ *
+ * @param[in] hash full-width key-hash function
+ * @param[in] is_equals key-equality function
+ * @param[in] segments amount of independently locked segments, rounded up to a power of two (0 for a default of 64)
+ * @return instance of the concurrent hashmap
+ */
+chashmap_ds *alloc_chashmap(size_t hash(const void*), int is_equals(const void*, const void*), size_t segments);
+
+/**
+ * Deallocates a concurrent hashmap. No other thread may be using it anymore.
+ *
+ * @param this deallocates the given concurrent hashmap
+ */
+void dealloc_chashmap(chashmap_ds *this);
+
+/**
+ * Puts a new key/value pair in the concurrent hashmap if it doesn't exist already, otherwise value is replaced.
+ *
+ * @param this given concurrent hashmap instance
+ * @param[in] key given pointer to key
+ * @param[in] value given pointer to value
+ * @return NULL if key/value pair didn't exist prior to insertion, otherwise pointer to the old value that was associated with the key
+ */
+void *chashmap_put(chashmap_ds *this, void *key, void *value);
+
+/**
+ * Retrives a value mapped to the given key if it exists in the concurrent hashmap, without taking any lock.
+ *
+ * @param this given concurrent hashmap instance
+ * @param[in] key given pointer to key
+ * @return pointer to the value if the mapping exists, NULL otherwise
+ */
+void *chashmap_get(chashmap_ds *this, void *key);
+
+/**
+ * Removes a key/value pair in the concurrent hashmap with the given key if it exists, otherwise no effect occurs.
+ *
+ * @param this given concurrent hashmap instance
+ * @param[in] key given pointer to key
+ * @return value that was mapped to key if it exist prior to deletion, NULL otherwise
+ */
+void *chashmap_remove(chashmap_ds *this, void *key);
+
+/**
+ * Counts the key/value pairs of the concurrent hashmap. Segments are counted one after another, so the
+ * result is only exact if no writer runs at the same time.
+ *
+ * @param this given concurrent hashmap instance
+ * @return amount of key/value pairs
+ */
+size_t chashmap_size(chashmap_ds *this);
+
+#endif
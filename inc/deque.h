@@ -1,11 +1,24 @@
 #ifndef DEQUE_H
 #define DEQUE_H
 
+#include "ds_allocator.h"
+
 /**
- * Forward declaration of the deque data structure. Internally implemented as a growing dynamic array.
+ * Forward declaration of the deque data structure. Internally implemented as a growing circular array,
+ * or as a map of fixed-size blocks depending on its engine.
  */
 typedef struct deque_ds deque_ds;
 
+/**
+ * Storage strategies a deque can be allocated with. Both behave identically through this API.
+ *
+ * @see alloc_deque_engine(deque_engine)
+ */
+typedef enum deque_engine {
+	DEQUE_RING,		/**< one circular array, doubled and copied over when full (default) */
+	DEQUE_BLOCKS	/**< blocks of 512 elements that are allocated as the deque grows at either end and released as it drains, elements never move */
+} deque_engine;
+
 /**
  * Allocates a deque instance.
  *
@@ -13,6 +26,71 @@ typedef struct deque_ds deque_ds;
  */
 deque_ds *alloc_deque(void);
 
+/**
+ * Allocates a deque like alloc_deque() does, but storing its elements with the given engine. Prefer
+ * DEQUE_BLOCKS for deques that swing between empty and millions of elements: growing never copies
+ * elements (only a map holding a pointer per block), and the blocks are freed again as the deque drains.
+ *
+ * @param[in] engine storage strategy of the deque
+ * @return deque instance
+ */
+deque_ds *alloc_deque_engine(deque_engine engine);
+
+/**
+ * Allocates a deque like alloc_deque_engine() does, obtaining all of its memory from the given allocator.
+ *
+ * @param[in] engine storage strategy of the deque
+ * @param[in] allocator allocator of the deque's memory (NULL for ds_default_allocator)
+ * @return deque instance
+ */
+deque_ds *alloc_deque_with(deque_engine engine, const ds_allocator *allocator);
+
+/**
+ * Makes room for at least the given amount of elements, so that the deque doesn't grow until it holds more.
+ * The capacity also becomes a floor: a deque halves its storage by itself once it's only a quarter full (the
+ * array of DEQUE_RING, the map of blocks of DEQUE_BLOCKS), but never below the reserved capacity. DEQUE_BLOCKS
+ * only makes room in its map, blocks are still allocated as they're needed.
+ *
+ * @param this given deque instance
+ * @param[in] capacity amount of elements to make room for
+ */
+void deque_reserve(deque_ds *this, size_t capacity);
+
+/**
+ * Releases all memory the deque doesn't need for its current elements, and lifts the floor set by deque_reserve().
+ *
+ * @param this given deque instance
+ */
+void deque_shrink_to_fit(deque_ds *this);
+
+/**
+ * Caps the memory a DEQUE_BLOCKS deque keeps its elements in, for deques that may have to absorb a long
+ * backlog. Once its blocks take up more than the budget, the ones furthest from the left end are spilled to
+ * a temporary file (tmpfile()) in large sequential writes, and read back several blocks at a time as the left
+ * end catches up with them, as many as the budget has room for. Blocks pushed to the left are spilled as well once those further right are, so the
+ * budget holds whichever end the deque grows at. The leftmost and rightmost blocks always stay in memory, so
+ * pushes and pops at either end never wait for the file except when they reach a spilled block.
+ *
+ * Only the deque's own storage is spilled, the elements are stored as they are: pointers to memory that stays
+ * allocated, or integers and handles disguised as pointers. Elements of spilled blocks can still be accessed
+ * by deque_get(), deque_set() and deque_span(), through a copy of one block at a time that is written back once
+ * another spilled block is accessed. A run returned by deque_span() for a spilled block is also only valid until then.
+ *
+ * @param this given deque instance
+ * @param[in] bytes budget in bytes, at least three blocks of 512 elements (0 to read everything back and lift the budget)
+ * @return truey if the budget was set, falsey if the deque doesn't use DEQUE_BLOCKS or no temporary file could be created
+ */
+int deque_set_budget(deque_ds *this, size_t bytes);
+
+/**
+ * Counts the elements of the deque that are currently spilled to its temporary file.
+ *
+ * @param this given deque instance
+ * @return amount of spilled elements, a multiple of the block size
+ * @see deque_set_budget(deque_ds*, size_t)
+ */
+size_t deque_spilled(deque_ds *this);
+
 /**
  * Deallocates a deque.
  *
@@ -36,6 +114,17 @@ void deque_pushleft(deque_ds *this, void *el);
  */
 void deque_pushright(deque_ds *this, void *el);
 
+/**
+ * Inserts a whole array of elements at right of the deque, in order, as if each one was passed to
+ * deque_pushright(). The deque grows at most once, and the elements are copied in as few pieces as
+ * its storage allows (at most two for DEQUE_RING, one per block for DEQUE_BLOCKS).
+ *
+ * @param this given deque instance
+ * @param[in] els given elements
+ * @param[in] n amount of elements
+ */
+void deque_pushright_n(deque_ds *this, void *const *els, size_t n);
+
 /**
  * Removes and retrieves the element that was at left of the deque.
  *
@@ -52,6 +141,51 @@ void *deque_popleft(deque_ds *this);
  */
 void *deque_popright(deque_ds *this);
 
+/**
+ * Removes up to n elements at left of the deque, as if deque_popleft() was called that many times.
+ *
+ * @param this given deque instance
+ * @param[out] out array of at least n elements, the removed elements are stored to it from left to right
+ * @param[in] n maximum amount of elements to remove
+ * @return amount of elements that were removed, less than n only if the deque ran empty
+ */
+size_t deque_popleft_n(deque_ds *this, void **out, size_t n);
+
+/**
+ * Exposes the deque's storage directly: retrieves the longest contiguous run of elements starting at the
+ * given index (0 being the leftmost element). Visiting the whole deque takes at most two runs for DEQUE_RING
+ * (the array is split by its wraparound), or one per block for DEQUE_BLOCKS, e.g.
+ *
+ *     for (i = 0; i < deque_size(d); i += n) { void **run = deque_span(d, i, &n); ... }
+ *
+ * The elements may be read or replaced in place. The run is only valid until the next push or pop.
+ *
+ * @param this given deque instance
+ * @param[in] index index of the first element of the run
+ * @param[out] length amount of elements in the run, 0 if index is past the deque's size
+ * @return pointer to the first element of the run, NULL if index is past the deque's size
+ */
+void **deque_span(deque_ds *this, size_t index, size_t *length);
+
+/**
+ * Retrieves the element at the given index without removing it, in constant time for either engine.
+ *
+ * @param this given deque instance
+ * @param[in] index index of the element, 0 being the leftmost element
+ * @return element at the index, or NULL if index is past the deque's size
+ */
+void *deque_get(deque_ds *this, size_t index);
+
+/**
+ * Replaces the element at the given index, in constant time for either engine.
+ *
+ * @param this given deque instance
+ * @param[in] index index of the element, 0 being the leftmost element
+ * @param[in] el given element
+ * @return truey if the element was replaced, falsey if index is past the deque's size
+ */
+int deque_set(deque_ds *this, size_t index, void *el);
+
 /**
  * Retrives element at the left of the deque without removing it.
  *
@@ -106,4 +240,12 @@ void *deque_peekright(deque_ds *this);
  */
 int deque_isempty(deque_ds *this);
 
+/**
+ * Counts the elements of the deque.
+ *
+ * @param this given deque instance
+ * @return amount of elements
+ */
+size_t deque_size(deque_ds *this);
+
 #endif
@@ -0,0 +1,157 @@
+#ifndef DEQUE_TYPED_H
+#define DEQUE_TYPED_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ds_allocator.h"
+
+/**
+ * Type-specialized deques. DEFINE_DEQUE(name, type) generates a deque that copies its elements by value into
+ * the same power-of-two ring as deque_ds's ring engine, instead of storing pointers to them, so that queuing
+ * small structs takes neither an allocation per element nor a pointer chase per pop. Any element can be read
+ * or replaced in O(1) by its index from the left.
+ *
+ * The following is generated, all of it static so that the macro can be used in several translation units:
+ * - name: the deque itself
+ * - name *name##_alloc(void)
+ * - name *name##_alloc_with(const ds_allocator *allocator): obtains the deque and its ring from the given
+ *   allocator (NULL for ds_default_allocator)
+ * - void name##_dealloc(name *this)
+ * - void name##_pushleft(name *this, type el), void name##_pushright(name *this, type el)
+ * - int name##_popleft(name *this, type *out), int name##_popright(name *this, type *out): return truey if the
+ *   deque wasn't empty, in which case the removed element is stored to out unless it's NULL
+ * - type *name##_peekleft(name *this), type *name##_peekright(name *this): return NULL if the deque is empty
+ * - type *name##_get(name *this, size_t index): returns a pointer to the element at index (0 being the leftmost
+ *   element), NULL if index is past the deque's size
+ * - int name##_set(name *this, size_t index, type el): returns falsey if index is past the deque's size
+ * - size_t name##_size(name *this)
+ * - type *name##_next(name *this, size_t *index): iterates from left to right, starting with *index set to 0
+ *   and returning NULL after the rightmost element
+ * - type *name##_prev(name *this, size_t *index): iterates from right to left, starting with *index set to
+ *   name##_size(this) and returning NULL after the leftmost element
+ *
+ * Pointers returned by get, peek, next and prev are only valid until the next push or pop.
+ *
+ * @param name prefix of everything generated
+ * @param type type of the elements
+ */
+#define DEFINE_DEQUE(name, type)																						\
+typedef struct name {																									\
+	ds_allocator allocator;																								\
+	size_t head;																										\
+	size_t len;																											\
+	size_t capacity;																									\
+	type *ring;																											\
+} name;																													\
+																														\
+static DEQUE_TYPED_UNUSED name *name##_alloc_with(const ds_allocator *allocator) {										\
+	name *this;																											\
+	if (allocator == NULL) allocator = &ds_default_allocator;															\
+	this = ds_alloc(allocator, sizeof *this);																			\
+	DEQUE_TYPED_ASSERT(this != NULL, #name, "failed to allocate memory for new " #name);								\
+	this->allocator = *allocator;																						\
+	this->head = 0;																										\
+	this->len = 0;																										\
+	this->capacity = DEQUE_TYPED_INITIAL_CAPACITY;																		\
+	this->ring = ds_alloc(allocator, this->capacity * sizeof *this->ring);												\
+	DEQUE_TYPED_ASSERT(this->ring != NULL, #name, "failed to allocate memory for the elements");						\
+	return this;																										\
+}																														\
+																														\
+static DEQUE_TYPED_UNUSED name *name##_alloc(void) {																	\
+	return name##_alloc_with(&ds_default_allocator);																	\
+}																														\
+																														\
+static DEQUE_TYPED_UNUSED void name##_dealloc(name *const this) {														\
+	ds_free(&this->allocator, this->ring, this->capacity * sizeof *this->ring);											\
+	ds_free(&this->allocator, this, sizeof *this);																		\
+}																														\
+																														\
+/* doubles the full ring, moving the elements that wrapped around to slot 0 behind the others */						\
+static DEQUE_TYPED_UNUSED void name##_grow(name *const this) {															\
+	size_t size = this->capacity * sizeof *this->ring;																	\
+	type *ring = ds_realloc(&this->allocator, this->ring, size, size << 1);												\
+	DEQUE_TYPED_ASSERT(ring != NULL, #name, "failed to allocate memory for expanding the elements");					\
+	memcpy(ring + this->capacity, ring, this->head * sizeof *ring);														\
+	this->ring = ring;																									\
+	this->capacity <<= 1;																								\
+}																														\
+																														\
+static DEQUE_TYPED_UNUSED void name##_pushleft(name *const this, type el) {												\
+	if (this->len == this->capacity) name##_grow(this);																	\
+	this->head = (this->head - 1) & (this->capacity - 1);																\
+	this->ring[this->head] = el;																						\
+	this->len++;																										\
+}																														\
+																														\
+static DEQUE_TYPED_UNUSED void name##_pushright(name *const this, type el) {											\
+	if (this->len == this->capacity) name##_grow(this);																	\
+	this->ring[(this->head + this->len) & (this->capacity - 1)] = el;													\
+	this->len++;																										\
+}																														\
+																														\
+static DEQUE_TYPED_UNUSED int name##_popleft(name *const this, type *out) {												\
+	if (this->len == 0) return 0;																						\
+	if (out != NULL) *out = this->ring[this->head];																		\
+	this->head = (this->head + 1) & (this->capacity - 1);																\
+	this->len--;																										\
+	return 1;																											\
+}																														\
+																														\
+static DEQUE_TYPED_UNUSED int name##_popright(name *const this, type *out) {											\
+	if (this->len == 0) return 0;																						\
+	this->len--;																										\
+	if (out != NULL) *out = this->ring[(this->head + this->len) & (this->capacity - 1)];								\
+	return 1;																											\
+}																														\
+																														\
+static DEQUE_TYPED_UNUSED type *name##_get(name *const this, size_t index) {											\
+	if (index >= this->len) return NULL;																				\
+	return &this->ring[(this->head + index) & (this->capacity - 1)];													\
+}																														\
+																														\
+static DEQUE_TYPED_UNUSED int name##_set(name *const this, size_t index, type el) {										\
+	if (index >= this->len) return 0;																					\
+	this->ring[(this->head + index) & (this->capacity - 1)] = el;														\
+	return 1;																											\
+}																														\
+																														\
+static DEQUE_TYPED_UNUSED type *name##_peekleft(name *const this) {														\
+	return name##_get(this, 0);																							\
+}																														\
+																														\
+static DEQUE_TYPED_UNUSED type *name##_peekright(name *const this) {													\
+	return this->len != 0 ? name##_get(this, this->len - 1) : NULL;														\
+}																														\
+																														\
+static DEQUE_TYPED_UNUSED size_t name##_size(name *const this) {														\
+	return this->len;																									\
+}																														\
+																														\
+static DEQUE_TYPED_UNUSED type *name##_next(name *const this, size_t *index) {											\
+	if (*index >= this->len) return NULL;																				\
+	return &this->ring[(this->head + (*index)++) & (this->capacity - 1)];												\
+}																														\
+																														\
+static DEQUE_TYPED_UNUSED type *name##_prev(name *const this, size_t *index) {											\
+	if (*index == 0 || *index > this->len) return NULL;																	\
+	return &this->ring[(this->head + --(*index)) & (this->capacity - 1)];												\
+}
+
+/* generated functions the program doesn't use are no reason to warn */
+#ifdef __GNUC__
+#define DEQUE_TYPED_UNUSED __attribute__((unused))
+#else
+#define DEQUE_TYPED_UNUSED
+#endif
+
+#define DEQUE_TYPED_INITIAL_CAPACITY 16
+
+#define DEQUE_TYPED_ASSERT(BOOL_EXPR, NAME, MSG)																		\
+	if (!(BOOL_EXPR)) {																									\
+	fprintf(stderr, "**%s failure** : %s at %s:%d\n", NAME, MSG, __FILE__, __LINE__);									\
+	exit(EXIT_FAILURE);																									\
+}
+
+#endif
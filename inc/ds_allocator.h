@@ -0,0 +1,124 @@
+#ifndef DS_ALLOCATOR_H
+#define DS_ALLOCATOR_H
+
+#include <stddef.h>
+
+/**
+ * Memory allocator that a data structure obtains its internal memory from (structs, tables, nodes, ...).
+ * Every alloc_* function has a *_with variant taking one; the others use ds_default_allocator. Data structures
+ * keep their own copy of the allocator, but whatever context it points to must outlive them.
+ *
+ * Memory handed out to the caller (e.g. lists of entries) is still allocated with malloc, to be freed with free.
+ */
+typedef struct ds_allocator {
+	void *(*alloc)(void *context, size_t size);				/**< allocates size bytes suitably aligned for any type, NULL on failure */
+	void (*free)(void *context, void *ptr, size_t size);	/**< releases ptr, size being the size it was allocated with */
+	void *context;											/**< passed to alloc and free as is */
+} ds_allocator;
+
+/**
+ * Allocator that goes through malloc and free.
+ */
+extern const ds_allocator ds_default_allocator;
+
+/**
+ * Forward declaration of the bump arena. Internally implemented as a list of large blocks that allocations
+ * are carved out of one after another. Freeing is a no-op (except for the latest allocation), instead the
+ * whole arena is released at once: a data structure allocated in an arena can simply be dropped along with it,
+ * without deallocating it first.
+ */
+typedef struct ds_arena ds_arena;
+
+/**
+ * Forward declaration of the slab pool. Internally implemented as slabs of fixed-size objects threaded
+ * onto a free list, so allocating or freeing an object is a couple of pointer moves. Requests larger than
+ * the pool's object size are passed on to its backing allocator.
+ */
+typedef struct ds_pool ds_pool;
+
+/**
+ * Allocates memory with the given allocator.
+ *
+ * @param[in] allocator given allocator
+ * @param[in] size amount of bytes
+ * @return pointer to the memory, NULL if it couldn't be allocated
+ */
+void *ds_alloc(const ds_allocator *allocator, size_t size);
+
+/**
+ * Releases memory obtained from ds_alloc() or ds_realloc().
+ *
+ * @param[in] allocator allocator the memory was obtained from
+ * @param ptr pointer to the memory, NULL for no effect
+ * @param[in] size amount of bytes that were allocated
+ */
+void ds_free(const ds_allocator *allocator, void *ptr, size_t size);
+
+/**
+ * Resizes memory obtained from ds_alloc() or ds_realloc() like realloc does. The contents are preserved up to the smaller of both sizes. Unless the allocator is the default one,
+ * this means allocating anew and copying.
+ *
+ * @param[in] allocator allocator the memory was obtained from
+ * @param ptr pointer to the memory
+ * @param[in] old_size amount of bytes that were allocated
+ * @param[in] new_size amount of bytes to allocate
+ * @return pointer to the resized memory, NULL if it couldn't be allocated (ptr is left untouched then)
+ */
+void *ds_realloc(const ds_allocator *allocator, void *ptr, size_t old_size, size_t new_size);
+
+/**
+ * Allocates a bump arena.
+ *
+ * @param[in] block_size size of the blocks the arena reserves from malloc (0 for a default of 64 KiB), larger requests get a block of their own
+ * @return instance of the arena
+ */
+ds_arena *alloc_arena(size_t block_size);
+
+/**
+ * Deallocates an arena along with every allocation that was ever made from it.
+ *
+ * @param this deallocates the given arena
+ */
+void dealloc_arena(ds_arena *this);
+
+/**
+ * Releases every allocation that was made from the arena, but keeps its first block for reuse.
+ *
+ * @param this given arena instance
+ */
+void arena_reset(ds_arena *this);
+
+/**
+ * Retrieves an allocator that allocates from the arena.
+ *
+ * @param this given arena instance
+ * @return allocator backed by the arena
+ */
+ds_allocator arena_allocator(ds_arena *this);
+
+/**
+ * Allocates a slab pool.
+ *
+ * @param[in] object_size size of the objects handed out by the pool
+ * @param[in] objects_per_slab amount of objects per slab (0 for a default of 64)
+ * @param[in] backing allocator that slabs and larger requests are obtained from (NULL for ds_default_allocator)
+ * @return instance of the pool
+ */
+ds_pool *alloc_pool(size_t object_size, size_t objects_per_slab, const ds_allocator *backing);
+
+/**
+ * Deallocates a pool along with every slab, larger requests that weren't freed are left to the backing allocator.
+ *
+ * @param this deallocates the given pool
+ */
+void dealloc_pool(ds_pool *this);
+
+/**
+ * Retrieves an allocator that allocates from the pool.
+ *
+ * @param this given pool instance
+ * @return allocator backed by the pool
+ */
+ds_allocator pool_allocator(ds_pool *this);
+
+#endif
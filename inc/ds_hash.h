@@ -0,0 +1,77 @@
+#ifndef DS_HASH_H
+#define DS_HASH_H
+
+#include <stddef.h>
+
+/**
+ * Seeded hash functions for byte buffers, strings and integers, along with ready-made hash/equality pairs
+ * for keys that point to such things. All of them mix every input bit into every output bit, so unlike an
+ * identity hash their low bits can be used as a table index as is, which is what the hashmap does.
+ *
+ * The pairs hash with a seed that is drawn at random once per process, so that an adversary can't come up
+ * with keys that all collide. Hashes thus differ from one run to the next: anything that keeps them around
+ * for longer, like a hashmap snapshot, needs the seed to be fixed with ds_hash_set_seed() first.
+ */
+
+/**
+ * Retrieves the per-process seed, drawing it from the system's random source when first called.
+ *
+ * @return seed of the hash/equality pairs
+ */
+size_t ds_hash_seed(void);
+
+/**
+ * Replaces the per-process seed, e.g. to make hashes reproducible. This must happen before any data structure
+ * hashes with one of the pairs, as the hashes those already stored are only valid under the previous seed.
+ *
+ * @param[in] seed new seed of the hash/equality pairs
+ */
+void ds_hash_set_seed(size_t seed);
+
+/**
+ * Hashes a buffer of bytes. Long buffers are consumed in four independent lanes of words at a time,
+ * similar to xxHash, so that the multiplications of neighbouring words don't wait on each other.
+ *
+ * @param[in] data pointer to the bytes, not required to be aligned
+ * @param[in] length amount of bytes
+ * @param[in] seed seed to hash with
+ * @return full-width hash
+ */
+size_t ds_hash_bytes(const void *data, size_t length, size_t seed);
+
+/**
+ * Hashes a NUL-terminated string, giving the same hash as ds_hash_bytes() on its characters.
+ *
+ * @param[in] string given string
+ * @param[in] seed seed to hash with
+ * @return full-width hash
+ */
+size_t ds_hash_string(const char *string, size_t seed);
+
+/**
+ * Hashes an integer of up to the width of a size_t (32 or 64 bits). Narrower integers should be widened
+ * without sign extension, so that e.g. an int and an unsigned int of the same bits hash alike.
+ *
+ * @param[in] value given integer
+ * @param[in] seed seed to hash with
+ * @return full-width hash
+ */
+size_t ds_hash_word(size_t value, size_t seed);
+
+/**
+ * Hash/equality pairs for keys pointing to NUL-terminated strings, ints and longs. The int hashes go to
+ * alloc_hashmap(), alloc_hashset() or alloc_graph(), the 64 suffixed ones to alloc_hashmap64().
+ */
+int ds_string_hash(const void *key);
+size_t ds_string_hash64(const void *key);
+int ds_string_equals(const void *key_1, const void *key_2);
+
+int ds_int_hash(const void *key);
+size_t ds_int_hash64(const void *key);
+int ds_int_equals(const void *key_1, const void *key_2);
+
+int ds_long_hash(const void *key);
+size_t ds_long_hash64(const void *key);
+int ds_long_equals(const void *key_1, const void *key_2);
+
+#endif
@@ -17,6 +17,16 @@ typedef struct graph_ds graph_ds;
  */
 graph_ds *alloc_graph(int label_hash(const void*), int label_equals(const void*, const void*));
 
+/**
+ * Allocates a weighted undirected graph instance with given hash/equality functions, obtaining the graph, its
+ * hashmaps, vertices and edge weights from the given allocator. Traversals and searches take their deques
+ * and pqueues from it as well, including the deques they return.
+ *
+ * @param[in] allocator allocator of the graph's memory (NULL for ds_default_allocator)
+ * @return instance of the graph
+ */
+graph_ds *alloc_graph_with(int label_hash(const void*), int label_equals(const void*, const void*), const ds_allocator *allocator);
+
 /**
  * Deallocates a graph.
  *
@@ -1,27 +1,78 @@
 #ifndef HASHMAP_H
 #define HASHMAP_H
 
+#include "ds_allocator.h"
+
 /**
  * Basic unit of the hashmap: an entry. Some functions like hashmap_getentries(hashmap_ds*) will return
- * a list of entry pointers which contains easily accessible key-value pairs at your disposal.
+ * a list of entry pointers which contains easily accessible key-value pairs at your disposal. Entries
+ * live inline in the hashmap's table, so any pointer to an entry is only valid until the next put or
+ * remove on the same hashmap.
  */
 typedef struct hashmap_entry {
 	void *key;		/**< pointer to key */
 	void *value;	/**< pointer to value */
-	size_t psl;		/**< probe sequence length; outside modifications results in undefined behavior */
+	size_t hash;	/**< cached hash of the key; outside modifications results in undefined behavior */
 } hashmap_entry;
 
 /**
- * Forward declaration of the hashmap data structure. Internally implemented as
- * a dynamic list of entry pointers using robin-hood open addressing.
+ * Forward declaration of the hashmap data structure. Internally implemented as a flat table of
+ * inline entries using open addressing, with one byte of metadata per slot kept in its own dense
+ * array (probe sequence lengths for robin-hood probing, hash fingerprints for swiss probing).
  */
 typedef struct hashmap_ds hashmap_ds;
 
+/**
+ * Forward declaration of a copy-on-write snapshot of a hashmap, a read-only view of the hashmap as it was
+ * when the snapshot was taken. The snapshot shares the hashmap's table in chunks of a few hundred slots: the
+ * first time the hashmap writes to a chunk that a snapshot still shares, the chunk is copied for the snapshot.
+ *
+ * @see hashmap_snapshot(hashmap_ds*)
+ */
+typedef struct hashmap_snapshot_ds hashmap_snapshot_ds;
+
+/**
+ * Probing strategies a hashmap can be allocated with. Both store entries inline and behave identically
+ * through this API, they only differ in how the table is searched.
+ *
+ * @see alloc_hashmap_engine(int(*)(const void*), int(*)(const void*, const void*), hashmap_engine)
+ */
+typedef enum hashmap_engine {
+	HASHMAP_ROBINHOOD,	/**< robin-hood open addressing with backward shift deletion (default) */
+	HASHMAP_SWISS		/**< one hash fingerprint byte per slot, compared 16 slots at a time so that key equality is only tested on fingerprint matches */
+} hashmap_engine;
+
+/**
+ * Amount of buckets in the probe sequence length histogram of hashmap_stats.
+ */
+#define HASHMAP_PSL_BUCKETS 16
+
+/**
+ * Snapshot of a hashmap's instrumentation, filled by hashmap_getstats(). Probe sequence lengths are
+ * counted in slots for robin-hood probing and in groups of 16 slots for swiss probing, and so are probes.
+ * Everything but the probe sequence lengths is only counted while instrumentation is enabled.
+ *
+ * @see hashmap_set_stats(hashmap_ds*, int)
+ * @see hashmap_getstats(hashmap_ds*, hashmap_stats*)
+ */
+typedef struct hashmap_stats {
+	size_t psl_histogram[HASHMAP_PSL_BUCKETS];	/**< amount of entries per probe sequence length, the last bucket counts every longer one too */
+	size_t max_psl;								/**< longest probe sequence length of any entry */
+	size_t hits;								/**< lookups (gets and removes) that found their key */
+	size_t misses;								/**< lookups (gets and removes) that didn't find their key */
+	double probes_per_hit;						/**< average amount of probes of a lookup that found its key */
+	double probes_per_miss;						/**< average amount of probes of a lookup that didn't find its key */
+	size_t equality_calls;						/**< amount of calls to the key-equality function */
+	size_t hash_calls;							/**< amount of calls to the key-hash function */
+	size_t rehashes;							/**< amount of times the table was rebuilt */
+	double rehash_seconds;						/**< elapsed time spent rehashing, including incremental migration */
+} hashmap_stats;
+
 /**
  * This struct gives functionality to iterate through a hashmap non-destructively. At most, the values
  * could be modified for any entry returned. Despite the internals being visible, this shall be treated
  * as an opaque structure with the given functions only, as directly modifying the members can result in
- * undefined behavior.
+ * undefined behavior. Putting or removing keys while iterating invalidates the iterator.
  *
  * @see hashmap_getiterator(hashmap_ds*)
  * @see hashmap_iterator_hasnext(hashmap_ds_iterator*)
@@ -29,8 +80,8 @@ typedef struct hashmap_ds hashmap_ds;
  */
 typedef struct hashmap_ds_iterator {
 	size_t index; 				/**< current key/value pair out of current hashmap size */
+	size_t slot; 				/**< current slot of the hashmap's table */
 	hashmap_ds *map; 			/**< given hashmap instance */
-	hashmap_entry **entries; 	/**< given entries to iterate on */
 } hashmap_ds_iterator;
 
 /**
@@ -67,6 +118,31 @@ hashmap_entry *hashmap_iterator_next(hashmap_ds_iterator *itr);
  */
 hashmap_ds *alloc_hashmap(int hash(const void*), int is_equals(const void*, const void*));
 
+/**
+ * Allocates a hashmap like alloc_hashmap() does, but probing the table with the given engine. Prefer
+ * HASHMAP_SWISS for hashmaps that are mostly queried with keys they don't contain, or whose equality
+ * function is expensive.
+ *
+ * @param[in] hash key-hash function
+ * @param[in] is_equals key-equality function
+ * @param[in] engine probing strategy of the table
+ * @return instance of the hashmap
+ */
+hashmap_ds *alloc_hashmap_engine(int hash(const void*), int is_equals(const void*, const void*), hashmap_engine engine);
+
+/**
+ * Allocates a hashmap like alloc_hashmap_engine() does, but with a hash function as wide as size_t
+ * (64 bits on 64-bit platforms). Either way, the hash of every key is computed once when it's put and
+ * cached in its entry, so rehashing never calls the hash function again and is_equals is only called on
+ * keys whose cached hash matches.
+ *
+ * @param[in] hash full-width key-hash function
+ * @param[in] is_equals key-equality function
+ * @param[in] engine probing strategy of the table
+ * @return instance of the hashmap
+ */
+hashmap_ds *alloc_hashmap64(size_t hash(const void*), int is_equals(const void*, const void*), hashmap_engine engine);
+
 /**
  * Allocates a hashmap whose hash/equality is determined by the key's identity instead. Other properties
  * are still default according to alloc_hashmap()
@@ -75,6 +151,36 @@ hashmap_ds *alloc_hashmap(int hash(const void*), int is_equals(const void*, cons
  */
 hashmap_ds *alloc_identityhashmap(void);
 
+/**
+ * Allocates a hashmap like alloc_hashmap_engine() does, obtaining all of its memory from the given allocator.
+ *
+ * @param[in] hash key-hash function
+ * @param[in] is_equals key-equality function
+ * @param[in] engine probing strategy of the table
+ * @param[in] allocator allocator of the hashmap's memory (NULL for ds_default_allocator)
+ * @return instance of the hashmap
+ */
+hashmap_ds *alloc_hashmap_with(int hash(const void*), int is_equals(const void*, const void*), hashmap_engine engine, const ds_allocator *allocator);
+
+/**
+ * Allocates a hashmap like alloc_hashmap64() does, obtaining all of its memory from the given allocator.
+ *
+ * @param[in] hash full-width key-hash function
+ * @param[in] is_equals key-equality function
+ * @param[in] engine probing strategy of the table
+ * @param[in] allocator allocator of the hashmap's memory (NULL for ds_default_allocator)
+ * @return instance of the hashmap
+ */
+hashmap_ds *alloc_hashmap64_with(size_t hash(const void*), int is_equals(const void*, const void*), hashmap_engine engine, const ds_allocator *allocator);
+
+/**
+ * Allocates an identity hashmap like alloc_identityhashmap() does, obtaining all of its memory from the given allocator.
+ *
+ * @param[in] allocator allocator of the hashmap's memory (NULL for ds_default_allocator)
+ * @return instance of the identity hashmap
+ */
+hashmap_ds *alloc_identityhashmap_with(const ds_allocator *allocator);
+
 /**
  * Deallocates a hashmap.
  *
@@ -82,6 +188,28 @@ hashmap_ds *alloc_identityhashmap(void);
  */
 void dealloc_hashmap(hashmap_ds *this);
 
+/**
+ * Switches the hashmap to incremental rehashing. Instead of rebuilding the whole table inside the put that
+ * exceeds the load factor, the old and the grown table then coexist and every put, get and remove migrates
+ * at most the given amount of slots until the old table is drained. Note that this means gets may move
+ * entries around too while a migration is underway. Passing 0 restores rehashing all at once, finishing
+ * any migration in progress.
+ *
+ * @param this given hashmap instance
+ * @param[in] slots amount of slots of the old table migrated per operation
+ */
+void hashmap_set_rehash_step(hashmap_ds *this, size_t slots);
+
+/**
+ * Lets rehashes that happen all at once split the work across the given amount of threads, once the hashmap
+ * holds enough pairs for that to pay off. Only tables using the robin-hood engine rehash in parallel, and
+ * the hash and equality functions are then called from several threads at once.
+ *
+ * @param this given hashmap instance
+ * @param[in] threads amount of threads a rehash may use (0 or 1 to rehash on the calling thread alone)
+ */
+void hashmap_set_rehash_threads(hashmap_ds *this, size_t threads);
+
 /**
  * Puts a new key/value pair in the hashmap if it doesn't exist already, otherwise value is replaced.
  *
@@ -120,8 +248,202 @@ void *hashmap_get_keyref(hashmap_ds *this, void *key);
  */
 void *hashmap_remove(hashmap_ds *this, void *key);
 
+/**
+ * Retrieves the values mapped to a whole array of keys. Keys are hashed and their slots prefetched a batch
+ * at a time before any of them is probed, so that the memory latency of one lookup overlaps the others.
+ *
+ * @param this given hashmap instance
+ * @param[in] keys given array of pointers to keys
+ * @param[in] n length of the keys array
+ * @param[out] out_values array of at least n values, each one set like hashmap_get() would return it
+ * @return amount of keys that were mapped in the hashmap
+ */
+size_t hashmap_get_many(hashmap_ds *this, void *const *keys, size_t n, void **out_values);
+
+/**
+ * Puts a whole array of key/value pairs in the hashmap, hashing and prefetching them in batches like
+ * hashmap_get_many() does. Pairs are put in order, so a key repeated in the array ends up mapped to its
+ * last value.
+ *
+ * @param this given hashmap instance
+ * @param[in] keys given array of pointers to keys
+ * @param[in] values given array of pointers to values, parallel to keys
+ * @param[in] n length of the keys and values arrays
+ * @param[out] out_oldvalues array of at least n values, each one set like hashmap_put() would return it (nullable)
+ */
+void hashmap_put_many(hashmap_ds *this, void *const *keys, void *const *values, size_t n, void **out_oldvalues);
+
+/**
+ * Puts many key/value pairs at once, with the same outcome as hashmap_put_many(). The table is grown once
+ * to fit all pairs, then the pairs are hashed and put by the given amount of threads, each one owning a
+ * contiguous range of the table that no other thread writes to. The hash and equality functions are thus
+ * called from several threads at once, and hashmap_getstats() doesn't count the equality checks they make.
+ * Tables using the swiss engine only hash in parallel and put the pairs on the calling thread.
+ *
+ * @param this given hashmap instance
+ * @param[in] keys keys to put
+ * @param[in] values values to map the keys to, where later pairs of the same key win
+ * @param[in] n amount of pairs
+ * @param[in] threads amount of threads to build with, fewer are used for small tables
+ */
+void hashmap_build(hashmap_ds *this, void *const *keys, void *const *values, size_t n, size_t threads);
+
+/**
+ * Removes every entry the predicate rejects, in a single pass over the table instead of one search and one
+ * backward shift per removal. The predicate is called exactly once per entry, and may e.g. free the key and
+ * value of an entry it rejects, but must not put into or remove from the hashmap itself. A migration in
+ * progress is finished first.
+ *
+ * @param this given hashmap instance
+ * @param[in] predicate returns truey to keep the entry, falsey to remove it
+ * @param context passed to the predicate as is
+ * @return amount of entries removed
+ */
+size_t hashmap_retain(hashmap_ds *this, int predicate(hashmap_entry *entry, void *context), void *context);
+
+/**
+ * Removes a whole array of keys from the hashmap. Unless there are only a few of them compared to the size of
+ * the table, the keys are looked up first and then removed all at once in a single pass over the table, like
+ * hashmap_retain() does. A migration in progress is finished first.
+ *
+ * @param this given hashmap instance
+ * @param[in] keys given array of pointers to keys
+ * @param[in] n length of the keys array
+ * @param[out] out_oldvalues array of at least n values, each one set like hashmap_remove() would return it (nullable)
+ * @return amount of entries removed
+ */
+size_t hashmap_remove_many(hashmap_ds *this, void *const *keys, size_t n, void **out_oldvalues);
+
+/**
+ * Enables or disables the instrumentation of a hashmap. Enabling it (again) starts every counter from zero;
+ * a hashmap that isn't instrumented pays no more than a branch per hash or equality call.
+ *
+ * @param this given hashmap instance
+ * @param[in] enabled truey to start counting, falsey to stop
+ */
+void hashmap_set_stats(hashmap_ds *this, int enabled);
+
+/**
+ * Retrieves the instrumentation of a hashmap. The probe sequence lengths are computed from the table
+ * on every call, so they're available even if instrumentation was never enabled.
+ *
+ * @param this given hashmap instance
+ * @param[out] stats filled with the hashmap's current instrumentation
+ */
+void hashmap_getstats(hashmap_ds *this, hashmap_stats *stats);
+
+/**
+ * Saves the hashmap to a snapshot file that hashmap_load() or hashmap_load64() can later map back into memory
+ * without putting anything again. The table is written as is, and every key and value is written as the bytes
+ * reported by the given callbacks. Once loaded, a pointer to those bytes stands in for the original key or value,
+ * so the hash/equality functions must treat both the same way (e.g. NUL-terminated strings or plain structs).
+ * Snapshots can only be loaded on the same kind of platform they were saved on.
+ *
+ * @param this given hashmap instance
+ * @param[in] path path of the snapshot file, replaced if it exists
+ * @param[in] key_bytes retrieves the bytes of a key and their length through len, NULL to save the key as NULL
+ * @param[in] value_bytes retrieves the bytes of a value and their length through len, NULL to save the value as NULL
+ * @return truey if the snapshot was saved, falsey otherwise
+ */
+int hashmap_save(hashmap_ds *this, const char *path, const void *key_bytes(const void *key, size_t *len), const void *value_bytes(const void *value, size_t *len));
+
+/**
+ * Loads a snapshot saved by hashmap_save() from a hashmap with an int hash function. The file is memory
+ * mapped: neither the hash function nor the equality function are called, and the payloads are only read
+ * once they're used. The loaded hashmap is read-only, putting into or removing from it aborts the program,
+ * and it must still be deallocated with dealloc_hashmap().
+ *
+ * @param[in] path path of the snapshot file
+ * @param[in] hash key-hash function, returning the same hashes as the one of the saved hashmap
+ * @param[in] is_equals key-equality function
+ * @return read-only instance of the hashmap, or NULL if the file couldn't be loaded
+ */
+hashmap_ds *hashmap_load(const char *path, int hash(const void*), int is_equals(const void*, const void*));
+
+/**
+ * Loads a snapshot saved by hashmap_save() from a hashmap with a full-width hash function.
+ *
+ * @param[in] path path of the snapshot file
+ * @param[in] hash full-width key-hash function, returning the same hashes as the one of the saved hashmap
+ * @param[in] is_equals key-equality function
+ * @return read-only instance of the hashmap, or NULL if the file couldn't be loaded
+ * @see hashmap_load(const char*, int(*)(const void*), int(*)(const void*, const void*))
+ */
+hashmap_ds *hashmap_load64(const char *path, size_t hash(const void*), int is_equals(const void*, const void*));
+
+/**
+ * Scans the hashmap a few buckets at a time, Redis SCAN style: start with a cursor of 0 and keep passing the
+ * returned cursor back until it's 0 again. Nothing is allocated, and the hashmap may be modified in between
+ * calls. Every key that is present for the whole scan is passed to the callback at least once, even if the
+ * table grows or is being rehashed incrementally meanwhile; keys that are put or removed during the scan may
+ * or may not be, and a growing table may pass some keys more than once.
+ *
+ * The callback must not put into or remove from the hashmap, collect the keys instead and do so once the call
+ * returns. The entry is only valid during the callback.
+ *
+ * @param this given hashmap instance
+ * @param[in] cursor 0 to start a scan, otherwise the cursor returned by the previous call
+ * @param[in] batch amount of entries to aim for, whole buckets are scanned so a call may pass a few more or fewer
+ * @param[in] callback called with every entry that is scanned
+ * @param context passed to the callback as is
+ * @return cursor to continue the scan with, 0 if the scan is complete
+ */
+size_t hashmap_scan(hashmap_ds *this, size_t cursor, size_t batch, void callback(hashmap_entry *entry, void *context), void *context);
+
+/**
+ * Takes a copy-on-write snapshot of the hashmap without copying any entries. Snapshots are meant for readers
+ * on other threads: each one may be read from (and released by) a thread of its own while the hashmap keeps
+ * being modified, as long as the hashmap itself is only modified by a single thread at a time, the one that
+ * takes the snapshots. Modifications then only pay for copying a chunk the first time they touch it after a
+ * snapshot was taken, and readers take a lock only to copy a chunk the hashmap hasn't touched yet. A rehash
+ * copies all chunks that snapshots still share. An incremental rehash in progress is finished first.
+ *
+ * Changing a value through an entry pointer (e.g. from hashmap_getentries()) bypasses the copying, so such
+ * a change is visible to snapshots that still share the entry's chunk.
+ *
+ * @param this given hashmap instance
+ * @return snapshot of the hashmap, to be released with hashmap_snapshot_release()
+ */
+hashmap_snapshot_ds *hashmap_snapshot(hashmap_ds *this);
+
+/**
+ * Releases a snapshot. Snapshots may outlive their hashmap and may be released while it's being deallocated,
+ * but no snapshot may be read from meanwhile, since deallocating copies every chunk they still share.
+ *
+ * @param snapshot releases the given snapshot
+ */
+void hashmap_snapshot_release(hashmap_snapshot_ds *snapshot);
+
+/**
+ * Retrieves the value mapped to the given key as of when the snapshot was taken.
+ *
+ * @param snapshot given snapshot instance
+ * @param[in] key given pointer to key
+ * @return pointer to the value if the mapping existed, NULL otherwise
+ */
+void *hashmap_snapshot_get(hashmap_snapshot_ds *snapshot, void *key);
+
+/**
+ * Counts the key/value pairs of the snapshot.
+ *
+ * @param snapshot given snapshot instance
+ * @return amount of key/value pairs the hashmap had when the snapshot was taken
+ */
+size_t hashmap_snapshot_size(hashmap_snapshot_ds *snapshot);
+
+/**
+ * Iterates over the entries of the snapshot: start with *slot set to 0 and call again until NULL is returned.
+ * The entries stay valid until the snapshot is released.
+ *
+ * @param snapshot given snapshot instance
+ * @param slot position of the iteration, advanced past the returned entry
+ * @return next entry of the snapshot, NULL once all entries were visited
+ */
+hashmap_entry *hashmap_snapshot_next(hashmap_snapshot_ds *snapshot, size_t *slot);
+
 /**
  * Allocates a NULL-terminated list of entries for the given hashmap instance. Must be freed manually if you don't use it anymore!
+ * The listed entries point into the hashmap's table and are only valid until the next put or remove.
  *
  * @param[in] this given hashmap instance
  * @return dynamically allocated list of hashmap entries
@@ -0,0 +1,213 @@
+#ifndef HASHMAP_TYPED_H
+#define HASHMAP_TYPED_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+
+/**
+ * Type-specialized hashmaps. DEFINE_HASHMAP(name, key_type, value_type, hash_fn, eq_fn) generates a hashmap that
+ * stores its keys and values by value and calls hash_fn/eq_fn directly, so that the compiler is free to inline
+ * them instead of going through function pointers on every probe. The table is the same robin-hood table as
+ * hashmap_ds's: inline entries, probe sequence lengths kept in their own array of bytes, a load factor of 3/4
+ * and backward shift deletion. Since hash_fn is expected to be cheap, hashes aren't cached but recomputed on
+ * the rare occasions a probe sequence length doesn't fit in its byte.
+ *
+ * The following is generated, all of it static so that the macro can be used in several translation units:
+ * - name##_entry: an entry with a key and value member
+ * - name: the hashmap itself
+ * - name *name##_alloc(void)
+ * - void name##_dealloc(name *this)
+ * - int name##_put(name *this, key_type key, value_type value, value_type *oldvalue): returns truey if the key existed,
+ *   in which case its old value is stored to oldvalue unless it's NULL
+ * - value_type *name##_get(name *this, key_type key): returns a pointer to the value, NULL if the key doesn't exist
+ * - int name##_remove(name *this, key_type key, value_type *oldvalue): returns truey if the key existed
+ * - size_t name##_size(name *this)
+ * - name##_entry *name##_next(name *this, size_t *slot): iterates over the entries, starting with *slot set to 0
+ *   and returning NULL after the last one
+ *
+ * Like hashmap_ds's entries, pointers returned by get and next are only valid until the next put or remove.
+ *
+ * @param name prefix of everything generated
+ * @param key_type type of the keys
+ * @param value_type type of the values
+ * @param hash_fn function or macro hashing a key_type to a size_t
+ * @param eq_fn function or macro returning truey if two key_type are equal
+ */
+#define DEFINE_HASHMAP(name, key_type, value_type, hash_fn, eq_fn)														\
+typedef struct name##_entry {																							\
+	key_type key;																										\
+	value_type value;																									\
+} name##_entry;																											\
+																														\
+typedef struct name {																									\
+	size_t size;																										\
+	size_t capacity;																									\
+	size_t load_factor;																									\
+	name##_entry *table;																								\
+	unsigned char *psl;																									\
+} name;																													\
+																														\
+static HASHMAP_TYPED_UNUSED void name##_alloc_table(name *const this, size_t capacity) {								\
+	this->capacity = capacity;																							\
+	this->load_factor = (capacity * 3) >> 2;																			\
+	this->table = malloc(capacity * sizeof *this->table);																\
+	HASHMAP_TYPED_ASSERT(this->table != NULL, #name, "failed to allocate memory for the entries");						\
+	this->psl = calloc(capacity, sizeof *this->psl);																	\
+	HASHMAP_TYPED_ASSERT(this->psl != NULL, #name, "failed to allocate memory for the probe sequence lengths");			\
+}																														\
+																														\
+static HASHMAP_TYPED_UNUSED name *name##_alloc(void) {																	\
+	name *this = malloc(sizeof *this);																					\
+	HASHMAP_TYPED_ASSERT(this != NULL, #name, "failed to allocate memory for new " #name);								\
+	this->size = 0;																										\
+	name##_alloc_table(this, HASHMAP_TYPED_INITIAL_CAPACITY);															\
+	return this;																										\
+}																														\
+																														\
+static HASHMAP_TYPED_UNUSED void name##_dealloc(name *const this) {														\
+	free(this->table);																									\
+	free(this->psl);																									\
+	free(this);																											\
+}																														\
+																														\
+static HASHMAP_TYPED_UNUSED size_t name##_slot_psl(const name *const this, size_t i) {									\
+	if (this->psl[i] != HASHMAP_TYPED_PSL_SATURATED) return this->psl[i] - 1;											\
+	return (i - (size_t)hash_fn(this->table[i].key)) & (this->capacity - 1);											\
+}																														\
+																														\
+static HASHMAP_TYPED_UNUSED name##_entry *name##_search(name *const this, key_type key) {								\
+	size_t dist, mask = this->capacity - 1;																				\
+	size_t i = (size_t)hash_fn(key) & mask;																				\
+	for (dist = 0; this->psl[i] != HASHMAP_TYPED_PSL_VACANT; i = (i+1) & mask, dist++) {								\
+		/* the key would have displaced any occupant that is closer to its home than we are */							\
+		if (this->psl[i] != HASHMAP_TYPED_PSL_SATURATED && (size_t)(this->psl[i] - 1) < dist) break;					\
+		if (eq_fn(this->table[i].key, key)) return &this->table[i];														\
+	}																													\
+	return NULL;																										\
+}																														\
+																														\
+static HASHMAP_TYPED_UNUSED int name##_place(name *const this, name##_entry insertion, int unique, value_type *oldvalue) {	\
+	size_t dist, occupant_dist, mask = this->capacity - 1;																\
+	size_t i = (size_t)hash_fn(insertion.key) & mask;																	\
+	for (dist = 0; this->psl[i] != HASHMAP_TYPED_PSL_VACANT; i = (i+1) & mask, dist++) {								\
+		if (!unique && eq_fn(this->table[i].key, insertion.key)) {														\
+			if (oldvalue != NULL) *oldvalue = this->table[i].value;														\
+			this->table[i].value = insertion.value;																		\
+			return 1;																									\
+		}																												\
+		occupant_dist = name##_slot_psl(this, i);																		\
+		if (dist > occupant_dist) {																						\
+			/* swap */																									\
+			name##_entry temp = this->table[i];																			\
+			this->table[i] = insertion;																					\
+			this->psl[i] = HASHMAP_TYPED_PSL_BYTE(dist);																\
+																														\
+			/* find new spot, the displaced entry can't be equal to anything further down */							\
+			insertion = temp;																							\
+			dist = occupant_dist;																						\
+			unique = 1;																									\
+		}																												\
+	}																													\
+	this->table[i] = insertion;																							\
+	this->psl[i] = HASHMAP_TYPED_PSL_BYTE(dist);																		\
+	this->size++;																										\
+	return 0;																											\
+}																														\
+																														\
+static HASHMAP_TYPED_UNUSED void name##_rehash(name *const this) {														\
+	size_t i, capacity = this->capacity;																				\
+	name##_entry *table = this->table;																					\
+	unsigned char *psl = this->psl;																						\
+	this->size = 0;																										\
+	name##_alloc_table(this, capacity << 1);																			\
+	for (i = 0; i < capacity; i++) {																					\
+		if (psl[i] != HASHMAP_TYPED_PSL_VACANT) name##_place(this, table[i], 1, NULL);									\
+	}																													\
+	free(table);																										\
+	free(psl);																											\
+}																														\
+																														\
+static HASHMAP_TYPED_UNUSED int name##_put(name *const this, key_type key, value_type value, value_type *oldvalue) {	\
+	name##_entry insertion;																								\
+	insertion.key = key;																								\
+	insertion.value = value;																							\
+	if (name##_place(this, insertion, 0, oldvalue)) return 1;															\
+	if (this->size >= this->load_factor) name##_rehash(this);															\
+	return 0;																											\
+}																														\
+																														\
+static HASHMAP_TYPED_UNUSED value_type *name##_get(name *const this, key_type key) {									\
+	name##_entry *entry = name##_search(this, key);																		\
+	return entry != NULL ? &entry->value : NULL;																		\
+}																														\
+																														\
+static HASHMAP_TYPED_UNUSED int name##_remove(name *const this, key_type key, value_type *oldvalue) {					\
+	size_t i, next, mask = this->capacity - 1;																			\
+	name##_entry *entry = name##_search(this, key);																		\
+	if (entry == NULL) return 0;																						\
+	if (oldvalue != NULL) *oldvalue = entry->value;																		\
+																														\
+	/* engage backward shifting */																						\
+	i = (size_t)(entry - this->table);																					\
+	for (next = (i+1) & mask; this->psl[next] > HASHMAP_TYPED_PSL_BYTE(0); i = next, next = (next+1) & mask) {			\
+		this->table[i] = this->table[next];																				\
+		this->psl[i] = HASHMAP_TYPED_PSL_BYTE(name##_slot_psl(this, next) - 1);											\
+	}																													\
+	this->psl[i] = HASHMAP_TYPED_PSL_VACANT;																			\
+	this->size--;																										\
+	return 1;																											\
+}																														\
+																														\
+static HASHMAP_TYPED_UNUSED size_t name##_size(name *const this) {														\
+	return this->size;																									\
+}																														\
+																														\
+static HASHMAP_TYPED_UNUSED name##_entry *name##_next(name *const this, size_t *slot) {									\
+	while (*slot < this->capacity) {																					\
+		size_t i = (*slot)++;																							\
+		if (this->psl[i] != HASHMAP_TYPED_PSL_VACANT) return &this->table[i];											\
+	}																													\
+	return NULL;																										\
+}
+
+/* generated functions the program doesn't use are no reason to warn */
+#ifdef __GNUC__
+#define HASHMAP_TYPED_UNUSED __attribute__((unused))
+#else
+#define HASHMAP_TYPED_UNUSED
+#endif
+
+#define HASHMAP_TYPED_INITIAL_CAPACITY 16
+
+/* probe sequence lengths are stored biased by one so that zero can mark a vacant slot */
+#define HASHMAP_TYPED_PSL_VACANT 0
+#define HASHMAP_TYPED_PSL_SATURATED UCHAR_MAX
+#define HASHMAP_TYPED_PSL_BYTE(psl) ((psl) < HASHMAP_TYPED_PSL_SATURATED - 1 ? (unsigned char)((psl) + 1) : HASHMAP_TYPED_PSL_SATURATED)
+
+#define HASHMAP_TYPED_ASSERT(BOOL_EXPR, NAME, MSG)																		\
+	if (!(BOOL_EXPR)) {																									\
+	fprintf(stderr, "**%s failure** : %s at %s:%d\n", NAME, MSG, __FILE__, __LINE__);									\
+	exit(EXIT_FAILURE);																									\
+}
+
+/**
+ * Ready-made hash for integer and pointer keys, scrambling the bits since the table uses the low ones.
+ */
+#define HASHMAP_TYPED_INT_HASH(key) hashmap_typed_int_hash((size_t)(key))
+
+/**
+ * Ready-made equality for keys that compare with ==.
+ */
+#define HASHMAP_TYPED_EQUALS(a, b) ((a) == (b))
+
+static HASHMAP_TYPED_UNUSED size_t hashmap_typed_int_hash(size_t key) {
+	key ^= key >> 16;
+	key *= 0x45d9f3bu;
+	key ^= key >> 16;
+	key *= 0x45d9f3bu;
+	key ^= key >> 16;
+	return key;
+}
+
+#endif
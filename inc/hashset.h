@@ -0,0 +1,109 @@
+#ifndef HASHSET_H
+#define HASHSET_H
+
+#include "ds_allocator.h"
+
+/**
+ * Forward declaration of the hashset data structure. Internally implemented with the same robin-hood table
+ * as the hashmap, except that slots hold nothing but a key: no value, and no cached hash either. A key costs
+ * a pointer plus one byte of probe sequence length, in exchange the hash function is called again whenever
+ * the table grows (and on the rare probe sequence that is too long for its byte).
+ */
+typedef struct hashset_ds hashset_ds;
+
+/**
+ * Allocates a hashset instance with given hash/equality functions, a default capacity of 16 and a default
+ * load factor of 0.75.
+ *
+ * @param[in] hash key-hash function
+ * @param[in] is_equals key-equality function
+ * @return instance of the hashset
+ */
+hashset_ds *alloc_hashset(int hash(const void*), int is_equals(const void*, const void*));
+
+/**
+ * Allocates a hashset like alloc_hashset() does, obtaining all of its memory from the given allocator.
+ *
+ * @param[in] hash key-hash function
+ * @param[in] is_equals key-equality function
+ * @param[in] allocator allocator of the hashset's memory (NULL for ds_default_allocator)
+ * @return instance of the hashset
+ */
+hashset_ds *alloc_hashset_with(int hash(const void*), int is_equals(const void*, const void*), const ds_allocator *allocator);
+
+/**
+ * Deallocates a hashset.
+ *
+ * @param this deallocates the given hashset
+ */
+void dealloc_hashset(hashset_ds *this);
+
+/**
+ * Adds a key to the hashset if it doesn't contain an equal key already.
+ *
+ * @param this given hashset instance
+ * @param[in] key given pointer to key
+ * @return truey if the key was added, falsey if an equal key existed prior to insertion
+ */
+int hashset_add(hashset_ds *this, void *key);
+
+/**
+ * Checks whether the hashset contains a key equal to the given one.
+ *
+ * @param this given hashset instance
+ * @param[in] key given pointer to key
+ * @return truey if the key exists, falsey otherwise
+ */
+int hashset_contains(hashset_ds *this, const void *key);
+
+/**
+ * Removes the key equal to the given one from the hashset if it exists, otherwise no effect occurs.
+ *
+ * @param this given hashset instance
+ * @param[in] key given pointer to key
+ * @return the key that was in the hashset prior to deletion, NULL otherwise
+ */
+void *hashset_remove(hashset_ds *this, const void *key);
+
+/**
+ * Counts the keys of the hashset.
+ *
+ * @param this given hashset instance
+ * @return amount of keys
+ */
+size_t hashset_size(hashset_ds *this);
+
+/**
+ * Adds every key of another hashset to this one, i.e. their union. Both hashsets should use the same
+ * hash/equality functions.
+ *
+ * @param this given hashset instance, receives the union
+ * @param[in] other hashset whose keys are added
+ */
+void hashset_union(hashset_ds *this, hashset_ds *other);
+
+/**
+ * Removes every key that another hashset doesn't contain from this one, i.e. their intersection.
+ *
+ * @param this given hashset instance, receives the intersection
+ * @param[in] other hashset whose keys are kept
+ */
+void hashset_intersection(hashset_ds *this, hashset_ds *other);
+
+/**
+ * Removes every key that another hashset contains from this one, i.e. their difference.
+ *
+ * @param this given hashset instance, receives the difference
+ * @param[in] other hashset whose keys are removed
+ */
+void hashset_difference(hashset_ds *this, hashset_ds *other);
+
+/**
+ * Allocates a NULL-terminated list of the keys of the hashset. The list must be freed once done.
+ *
+ * @param this given hashset instance
+ * @return dynamically allocated list of keys
+ */
+void **hashset_getkeys(hashset_ds *this);
+
+#endif
@@ -0,0 +1,151 @@
+#ifndef DS_ROBINHOOD_H
+#define DS_ROBINHOOD_H
+
+/*
+ * Robin-hood probing shared by the tables of the hashmap and the hashset, for inclusion by their sources only.
+ * The including file describes its table before including this one:
+ * - RH_TABLE: the struct of the table, with fields size, capacity (a power of two), table (array of RH_SLOT)
+ *   and meta (array of one byte per slot holding its probe sequence length)
+ * - RH_SLOT: the type of a slot
+ * - RH_KEY(slot): the key of a slot
+ * - RH_SLOT_HASH(this, i): the hash of the key in slot i
+ * - RH_MATCHES(this, i, key, hash): whether slot i holds the given key of the given hash
+ * - RH_TOUCH(this, i): called before slot i is written to (optional)
+ * - RH_PROBES(this, n): called with the amount of slots a search probed (optional)
+ */
+
+#if !defined(RH_TABLE) || !defined(RH_SLOT) || !defined(RH_KEY) || !defined(RH_SLOT_HASH) || !defined(RH_MATCHES)
+#error The table must be described via defining RH_TABLE, RH_SLOT, RH_KEY, RH_SLOT_HASH and RH_MATCHES
+#endif
+
+#include <limits.h>
+
+#ifndef RH_TOUCH
+#define RH_TOUCH(this, i) ((void)0)
+#endif
+
+#ifndef RH_PROBES
+#define RH_PROBES(this, n) ((void)0)
+#endif
+
+/* probe sequence lengths are stored biased by one so that zero can mark a vacant slot */
+#define PSL_VACANT 0
+#define PSL_SATURATED UCHAR_MAX
+#define PSL_BYTE(psl) ((psl) < PSL_SATURATED - 1 ? (unsigned char)((psl) + 1) : PSL_SATURATED)
+
+/* exact probe sequence length of an occupied slot, only long chains need the hash of the key */
+static size_t robinhood_slot_psl(RH_TABLE *const this, size_t i) {
+	if (this->meta[i] != PSL_SATURATED) return this->meta[i] - 1;
+	return (i - RH_SLOT_HASH(this, i)) & (this->capacity - 1);
+}
+
+/* returns the slot holding the key, or the capacity of the table if the key is absent */
+static size_t robinhood_search(RH_TABLE *const this, const void *key, size_t hash) {
+	size_t dist, mask = this->capacity - 1;
+	size_t i = hash & mask;
+	for (dist = 0; this->meta[i] != PSL_VACANT; i = (i+1) & mask, dist++) {
+		/* the key would have displaced any occupant that is closer to its home than we are */
+		if (this->meta[i] != PSL_SATURATED && (size_t)(this->meta[i] - 1) < dist) {
+			break;
+		}
+		if (RH_MATCHES(this, i, key, hash)) {
+			RH_PROBES(this, dist + 1);
+			return i;
+		}
+	}
+	RH_PROBES(this, dist + 1);
+	return this->capacity;
+}
+
+/*
+ * Places the insertion unless its key is already present, in which case the slot holding it is returned and
+ * nothing changes. Otherwise the capacity of the table is returned. A unique insertion is known to be absent
+ * from the table, so no key is compared.
+ */
+static size_t robinhood_insert(RH_TABLE *const this, RH_SLOT insertion, size_t hash, int unique) {
+	int displaced = unique;
+	size_t dist, occupant_dist, mask = this->capacity - 1;
+	size_t i = hash & mask;
+	
+	for (dist = 0; this->meta[i] != PSL_VACANT; i = (i+1) & mask, dist++) {
+		if (!displaced && RH_MATCHES(this, i, RH_KEY(insertion), hash)) {
+			return i;
+		}
+		
+		occupant_dist = robinhood_slot_psl(this, i);
+		if (dist > occupant_dist) {
+			/* swap */
+			RH_SLOT temp = this->table[i];
+			RH_TOUCH(this, i);
+			this->table[i] = insertion;
+			this->meta[i] = PSL_BYTE(dist);
+			
+			/* find new spot */
+			insertion = temp;
+			dist = occupant_dist;
+			displaced = 1;
+		}
+	}
+	
+	RH_TOUCH(this, i);
+	this->table[i] = insertion;
+	this->meta[i] = PSL_BYTE(dist);
+	this->size++;
+	return this->capacity;
+}
+
+/* leaves the size to the caller, like robinhood_compact() does */
+static void robinhood_erase(RH_TABLE *const this, size_t i) {
+	size_t next, mask = this->capacity - 1;
+	
+	/* engage backward shifting */
+	for (next = (i+1) & mask; this->meta[next] > PSL_BYTE(0); i = next, next = (next+1) & mask) {
+		RH_TOUCH(this, i);
+		this->meta[i] = PSL_BYTE(robinhood_slot_psl(this, next) - 1);
+		this->table[i] = this->table[next];
+	}
+	RH_TOUCH(this, i);
+	this->meta[i] = PSL_VACANT;
+}
+
+/*
+ * Removes every doomed entry in one pass, shifting the survivors of each cluster back as far towards their home
+ * as the entries before them allow. Survivors keep their order, so the table ends up exactly as if each doomed
+ * entry had been erased by backward shifting on its own. The pass starts right after a vacant slot, where no
+ * cluster can be cut in half, and offsets are counted from there so that wrapping around needs no special case.
+ */
+static size_t robinhood_compact(RH_TABLE *const this, int doomed(RH_TABLE*, size_t, void*), void *context) {
+	size_t start, offset, psl, home, target, write = 1, removed = 0, mask = this->capacity - 1;
+	for (start = 0; this->meta[start] != PSL_VACANT; start++);
+	
+	for (offset = 1; offset < this->capacity; offset++) {
+		size_t i = (start + offset) & mask;
+		if (this->meta[i] == PSL_VACANT) {
+			write = offset + 1;
+			continue;
+		}
+		
+		psl = robinhood_slot_psl(this, i);
+		if (doomed(this, i, context)) {
+			RH_TOUCH(this, i);
+			this->meta[i] = PSL_VACANT;
+			removed++;
+			continue;
+		}
+		
+		home = offset - psl;
+		target = home > write ? home : write;
+		if (target != offset) {
+			size_t j = (start + target) & mask;
+			RH_TOUCH(this, j);
+			RH_TOUCH(this, i);
+			this->table[j] = this->table[i];
+			this->meta[j] = PSL_BYTE(target - home);
+			this->meta[i] = PSL_VACANT;
+		}
+		write = target + 1;
+	}
+	return removed;
+}
+
+#endif
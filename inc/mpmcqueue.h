@@ -0,0 +1,108 @@
+#ifndef MPMCQUEUE_H
+#define MPMCQUEUE_H
+
+#include <stddef.h>
+#include "ds_allocator.h"
+
+/**
+ * Forward declaration of the multi-producer/multi-consumer queue data structure. Internally implemented as
+ * the same power-of-two ring as the deque, but bounded, where every slot carries a sequence number telling
+ * whether it's ready to be filled or emptied for the current lap of the ring (Vyukov's bounded queue).
+ * Producers claim slots by advancing a shared tail with compare-and-swap, consumers a shared head, so that
+ * threads only ever contend over the index of their own side and never take a lock.
+ *
+ * Any amount of threads may push and pop concurrently, and NULL can't be pushed.
+ */
+typedef struct mpmcqueue_ds mpmcqueue_ds;
+
+/**
+ * Allocates a multi-producer/multi-consumer queue instance.
+ *
+ * @param[in] capacity maximum amount of elements the queue holds, rounded up to a power of two
+ * @return queue instance
+ */
+mpmcqueue_ds *alloc_mpmcqueue(size_t capacity);
+
+/**
+ * Allocates a multi-producer/multi-consumer queue instance like alloc_mpmcqueue() does, obtaining its
+ * memory from the given allocator. Memory is only allocated and released here and in dealloc_mpmcqueue().
+ *
+ * @param[in] capacity maximum amount of elements the queue holds, rounded up to a power of two
+ * @param[in] allocator allocator of the queue's memory (NULL for ds_default_allocator)
+ * @return queue instance
+ */
+mpmcqueue_ds *alloc_mpmcqueue_with(size_t capacity, const ds_allocator *allocator);
+
+/**
+ * Deallocates a multi-producer/multi-consumer queue. No thread may be using it anymore.
+ *
+ * @param this deallocates the given queue
+ */
+void dealloc_mpmcqueue(mpmcqueue_ds *this);
+
+/**
+ * Inserts the given element at the tail of the queue, waiting for room if the queue is full.
+ *
+ * @param this given queue instance
+ * @param[in] el given element, not NULL
+ */
+void mpmcqueue_push(mpmcqueue_ds *this, void *el);
+
+/**
+ * Inserts the given element at the tail of the queue if there is room for it.
+ *
+ * @param this given queue instance
+ * @param[in] el given element, not NULL
+ * @return truey if the element was inserted, falsey if the queue is full
+ */
+int mpmcqueue_try_push(mpmcqueue_ds *this, void *el);
+
+/**
+ * Inserts as many of the given elements as there are consecutive free slots for at the tail of the queue,
+ * claiming all of them with a single compare-and-swap. The elements stay in order relative to each other,
+ * but pushes of other threads may be interleaved with the ones of later calls.
+ *
+ * @param this given queue instance
+ * @param[in] els given elements, none of them NULL
+ * @param[in] n amount of elements
+ * @return amount of elements that were inserted, the first ones of els
+ */
+size_t mpmcqueue_push_n(mpmcqueue_ds *this, void *const *els, size_t n);
+
+/**
+ * Removes and retrieves the element at the head of the queue, waiting for one if the queue is empty.
+ *
+ * @param this given queue instance
+ * @return removed element
+ */
+void *mpmcqueue_pop(mpmcqueue_ds *this);
+
+/**
+ * Removes and retrieves the element at the head of the queue if there is one.
+ *
+ * @param this given queue instance
+ * @return removed element, or NULL if the queue is empty
+ */
+void *mpmcqueue_try_pop(mpmcqueue_ds *this);
+
+/**
+ * Removes up to n consecutive elements at the head of the queue, claiming all of them with a single
+ * compare-and-swap.
+ *
+ * @param this given queue instance
+ * @param[out] out array of at least n elements, the removed elements are stored to it in order
+ * @param[in] n maximum amount of elements to remove
+ * @return amount of elements that were removed
+ */
+size_t mpmcqueue_pop_n(mpmcqueue_ds *this, void **out, size_t n);
+
+/**
+ * Approximates the amount of elements in the queue. With other threads running, pushes and pops that are
+ * still underway are counted as if they were done.
+ *
+ * @param this given queue instance
+ * @return amount of elements
+ */
+size_t mpmcqueue_size(mpmcqueue_ds *this);
+
+#endif
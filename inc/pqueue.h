@@ -1,10 +1,16 @@
 #ifndef PQUEUE_H
 #define PQUEUE_H
 
+#include "ds_allocator.h"
+
 /**
  * Forward declaration of the pqueue data structure. Internally implemented as a 4-ary heap with a hashmap
  * ensuring no duplicate elements (think unordered_map<element, index>). Elements are enqueued accordingly
  * to the given comparator function.
+ *
+ * Intrusive pqueues do without the hashmap: every element embeds a size_t handle, in which the pqueue keeps
+ * the element's position in the heap. Finding an element to update or remove then takes a single read instead
+ * of a hash lookup, and enqueueing allocates nothing besides growing the heap.
  */
 typedef struct pqueue_ds pqueue_ds;
 
@@ -16,6 +22,40 @@ typedef struct pqueue_ds pqueue_ds;
  */
 pqueue_ds *alloc_pqueue(int comparator(const void*,const void*));
 
+/**
+ * Allocates an pqueue instance with the given comparator function, obtaining the heap, its index hashmap
+ * and the index of every element from the given allocator.
+ *
+ * @param[in] comparator function that compares values
+ * @param[in] allocator allocator of the pqueue's memory (NULL for ds_default_allocator)
+ * @return instance of the pqueue
+ */
+pqueue_ds *alloc_pqueue_with(int comparator(const void*,const void*), const ds_allocator *allocator);
+
+/**
+ * Allocates an intrusive pqueue instance with the given comparator function. Elements must embed a size_t
+ * handle at the given offset, e.g. offsetof(struct task, handle), which the pqueue owns while the element is
+ * enqueued and which mustn't be written to meanwhile. Its value doesn't matter otherwise, so it needs no
+ * initialization and an element can be enqueued again after leaving the pqueue. An element can be in several
+ * intrusive pqueues at once as long as each has a handle of its own.
+ *
+ * @param[in] comparator function that compares values
+ * @param[in] handle_offset offset of the size_t handle within every element
+ * @return instance of the pqueue
+ */
+pqueue_ds *alloc_pqueue_intrusive(int comparator(const void*,const void*), size_t handle_offset);
+
+/**
+ * Allocates an intrusive pqueue instance like alloc_pqueue_intrusive() does, obtaining the heap from the
+ * given allocator.
+ *
+ * @param[in] comparator function that compares values
+ * @param[in] handle_offset offset of the size_t handle within every element
+ * @param[in] allocator allocator of the pqueue's memory (NULL for ds_default_allocator)
+ * @return instance of the pqueue
+ */
+pqueue_ds *alloc_pqueue_intrusive_with(int comparator(const void*,const void*), size_t handle_offset, const ds_allocator *allocator);
+
 /**
  * Deallocates a pqueue.
  *
@@ -42,7 +82,7 @@ void *pqueue_dequeue(pqueue_ds *this);
 
 /**
  * Given an element, checks to see if its priority has been changed and if so
- * the pqueue is updated.
+ * the pqueue is updated. Elements that aren't in the pqueue are ignored.
  *
  * @param this given pqueue instance
  * @param[in] element given element
@@ -59,6 +99,25 @@ void pqueue_update(pqueue_ds *this, void *element);
  */
 void *pqueue_remove(pqueue_ds *this, void *element);
 
+/**
+ * Makes room for at least the given amount of elements in the heap, so that it doesn't grow until the pqueue
+ * holds more. The capacity also becomes a floor: the heap halves itself once it's only a quarter full, but
+ * never below the reserved capacity.
+ *
+ * @param this given pqueue instance
+ * @param[in] capacity amount of elements to make room for
+ */
+void pqueue_reserve(pqueue_ds *this, size_t capacity);
+
+/**
+ * Releases all memory the pqueue doesn't need for its current elements, including the spare capacity of its
+ * index hashmap if it has one, and lifts the floor set by pqueue_reserve(). Takes time linear in the amount
+ * of elements.
+ *
+ * @param this given pqueue instance
+ */
+void pqueue_shrink_to_fit(pqueue_ds *this);
+
 /**
  * Retrieves the head of the pqueue without removing it.
  *
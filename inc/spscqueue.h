@@ -0,0 +1,91 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <stddef.h>
+#include "ds_allocator.h"
+
+/**
+ * Forward declaration of the single-producer/single-consumer queue data structure. Internally implemented
+ * as the same power-of-two ring as the deque, but bounded, with its head owned by the consumer and its tail
+ * by the producer. Neither side ever takes a lock: each publishes its own index with release semantics and
+ * reads the other's with acquire semantics, and only rereads it once the index it remembers is in the way.
+ * Both indices sit on cache lines of their own so that the two threads don't contend over them.
+ *
+ * Exactly one thread may push and exactly one thread may pop at a time, and NULL can't be pushed.
+ */
+typedef struct spscqueue_ds spscqueue_ds;
+
+/**
+ * Allocates a single-producer/single-consumer queue instance.
+ *
+ * @param[in] capacity maximum amount of elements the queue holds, rounded up to a power of two
+ * @return queue instance
+ */
+spscqueue_ds *alloc_spscqueue(size_t capacity);
+
+/**
+ * Allocates a single-producer/single-consumer queue instance like alloc_spscqueue() does, obtaining its
+ * memory from the given allocator. Memory is only allocated and released here and in dealloc_spscqueue().
+ *
+ * @param[in] capacity maximum amount of elements the queue holds, rounded up to a power of two
+ * @param[in] allocator allocator of the queue's memory (NULL for ds_default_allocator)
+ * @return queue instance
+ */
+spscqueue_ds *alloc_spscqueue_with(size_t capacity, const ds_allocator *allocator);
+
+/**
+ * Deallocates a single-producer/single-consumer queue. Neither thread may be using it anymore.
+ *
+ * @param this deallocates the given queue
+ */
+void dealloc_spscqueue(spscqueue_ds *this);
+
+/**
+ * Inserts the given element at the tail of the queue. Only the producer may call this.
+ *
+ * @param this given queue instance
+ * @param[in] el given element, not NULL
+ * @return truey if the element was inserted, falsey if the queue is full
+ */
+int spscqueue_push(spscqueue_ds *this, void *el);
+
+/**
+ * Removes and retrieves the element at the head of the queue. Only the consumer may call this.
+ *
+ * @param this given queue instance
+ * @return removed element, or NULL if the queue is empty
+ */
+void *spscqueue_pop(spscqueue_ds *this);
+
+/**
+ * Inserts as many of the given elements as fit at the tail of the queue, in order. They are copied in at
+ * most two pieces and published to the consumer all at once. Only the producer may call this.
+ *
+ * @param this given queue instance
+ * @param[in] els given elements, none of them NULL
+ * @param[in] n amount of elements
+ * @return amount of elements that were inserted, the first ones of els
+ */
+size_t spscqueue_push_n(spscqueue_ds *this, void *const *els, size_t n);
+
+/**
+ * Removes up to n elements at the head of the queue, handing their slots back to the producer all at once.
+ * Only the consumer may call this.
+ *
+ * @param this given queue instance
+ * @param[out] out array of at least n elements, the removed elements are stored to it in order
+ * @param[in] n maximum amount of elements to remove
+ * @return amount of elements that were removed
+ */
+size_t spscqueue_pop_n(spscqueue_ds *this, void **out, size_t n);
+
+/**
+ * Counts the elements of the queue. Either thread may call this, though with the other one running the
+ * count may be outdated as soon as it's returned.
+ *
+ * @param this given queue instance
+ * @return amount of elements
+ */
+size_t spscqueue_size(spscqueue_ds *this);
+
+#endif
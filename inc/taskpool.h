@@ -0,0 +1,73 @@
+#ifndef TASKPOOL_H
+#define TASKPOOL_H
+
+#include "ds_allocator.h"
+
+/**
+ * Forward declaration of the task pool, a fixed amount of worker threads scheduling tasks by work stealing.
+ * Every worker owns a wsdeque: tasks spawned from within a task go to the bottom of the spawning worker's
+ * own deque and are run depth-first by it, while idle workers steal the oldest, usually largest, tasks from
+ * the top of a random other worker's deque. Tasks spawned from outside the pool go through a single locked
+ * queue instead, which only the first tasks of a fan-out should need.
+ *
+ * Workers that find no task anywhere keep looking for a while as long as tasks are outstanding, since those
+ * may spawn more, then go to sleep until a task is spawned. A long-running task thus doesn't keep idle
+ * workers spinning.
+ */
+typedef struct taskpool_ds taskpool_ds;
+
+/**
+ * Allocates a task pool instance, starting its worker threads.
+ *
+ * @param[in] threads amount of worker threads (at least 1)
+ * @return task pool instance
+ */
+taskpool_ds *alloc_taskpool(int threads);
+
+/**
+ * Allocates a task pool instance like alloc_taskpool() does, obtaining the pool, its deques and its tasks
+ * from the given allocator. Tasks are allocated by whichever thread spawns them, so the allocator must be
+ * safe to call from several threads at once.
+ *
+ * @param[in] threads amount of worker threads (at least 1)
+ * @param[in] allocator allocator of the task pool's memory (NULL for ds_default_allocator)
+ * @return task pool instance
+ */
+taskpool_ds *alloc_taskpool_with(int threads, const ds_allocator *allocator);
+
+/**
+ * Waits for all outstanding tasks to finish, then stops the worker threads and deallocates the task pool.
+ * Must not be called from one of its own tasks.
+ *
+ * @param this deallocates the given task pool
+ */
+void dealloc_taskpool(taskpool_ds *this);
+
+/**
+ * Spawns a task that calls the given function with the given argument on one of the pool's workers. May be
+ * called from any thread, including from within the pool's own tasks, which is the cheapest way to spawn.
+ *
+ * @param this given task pool instance
+ * @param[in] run function of the task, receiving the task pool so it may spawn further tasks
+ * @param[in] arg argument of the task
+ */
+void taskpool_spawn(taskpool_ds *this, void run(taskpool_ds*, void*), void *arg);
+
+/**
+ * Waits until every task spawned so far has finished, along with every task those spawned in turn. Must
+ * not be called from one of the pool's own tasks.
+ *
+ * @param this given task pool instance
+ */
+void taskpool_wait(taskpool_ds *this);
+
+/**
+ * Retrieves the index of the worker running the calling thread, so that tasks can keep per-worker state
+ * (e.g. partial aggregates) without synchronizing on it.
+ *
+ * @param this given task pool instance
+ * @return index of the calling worker from 0 up to the amount of threads, or -1 if called from outside the pool
+ */
+int taskpool_worker(taskpool_ds *this);
+
+#endif
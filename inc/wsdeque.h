@@ -0,0 +1,76 @@
+#ifndef WSDEQUE_H
+#define WSDEQUE_H
+
+#include <stddef.h>
+#include "ds_allocator.h"
+
+/**
+ * Forward declaration of the work-stealing deque data structure (Chase-Lev). Internally implemented as a
+ * power-of-two ring like the deque's, with a bottom end that only its owner thread pushes to and pops from,
+ * and a top end that any other thread may steal from. The owner only races with thieves over the last
+ * element, so pushes take no atomic read-modify-write at all, and pops only take one for the last element.
+ * Thieves claim elements with compare-and-swap on the top index. Rings that are outgrown stay allocated
+ * until the deque is deallocated, since a thief may still be reading from them.
+ *
+ * Work pushed by the owner is popped back last in, first out, while thieves take the oldest work first.
+ * NULL can't be pushed.
+ */
+typedef struct wsdeque_ds wsdeque_ds;
+
+/**
+ * Allocates a work-stealing deque instance.
+ *
+ * @return work-stealing deque instance
+ */
+wsdeque_ds *alloc_wsdeque(void);
+
+/**
+ * Allocates a work-stealing deque instance like alloc_wsdeque() does, obtaining its memory from the given
+ * allocator. The owner thread may allocate more of it to grow the deque, so the allocator must be usable from it.
+ *
+ * @param[in] allocator allocator of the deque's memory (NULL for ds_default_allocator)
+ * @return work-stealing deque instance
+ */
+wsdeque_ds *alloc_wsdeque_with(const ds_allocator *allocator);
+
+/**
+ * Deallocates a work-stealing deque. No thread may be using it anymore.
+ *
+ * @param this deallocates the given work-stealing deque
+ */
+void dealloc_wsdeque(wsdeque_ds *this);
+
+/**
+ * Inserts the given element at the bottom of the deque, growing it if needed. Only the owner may call this.
+ *
+ * @param this given work-stealing deque instance
+ * @param[in] el given element, not NULL
+ */
+void wsdeque_push(wsdeque_ds *this, void *el);
+
+/**
+ * Removes and retrieves the element at the bottom of the deque, the one pushed last. Only the owner may call this.
+ *
+ * @param this given work-stealing deque instance
+ * @return removed element, or NULL if the deque is empty or a thief took its last element first
+ */
+void *wsdeque_pop(wsdeque_ds *this);
+
+/**
+ * Removes and retrieves the element at the top of the deque, the oldest one. Any thread may call this.
+ *
+ * @param this given work-stealing deque instance
+ * @return removed element, or NULL if the deque is empty or another thread took the element first
+ */
+void *wsdeque_steal(wsdeque_ds *this);
+
+/**
+ * Approximates the amount of elements in the deque. With other threads running, the count may be outdated
+ * as soon as it's returned.
+ *
+ * @param this given work-stealing deque instance
+ * @return amount of elements
+ */
+size_t wsdeque_size(wsdeque_ds *this);
+
+#endif
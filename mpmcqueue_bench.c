@@ -0,0 +1,157 @@
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include "deque.h"
+#include "mpmcqueue.h"
+
+#define MESSAGES_PER_THREAD 1000000
+#define CAPACITY 4096
+#define BATCH 64
+
+/* messages are small integers disguised as pointers, never dereferenced */
+#define MESSAGE(i) ((void*)(size_t)((i) + 1))
+
+mpmcqueue_ds *queue = NULL;
+deque_ds *deque = NULL;
+pthread_mutex_t deque_lock = PTHREAD_MUTEX_INITIALIZER;
+
+typedef struct bench_worker {
+	pthread_t thread;
+	size_t sum;
+} bench_worker;
+
+void *produce_mpmcqueue(void *arg) {
+	size_t i;
+	(void)arg;
+	for (i = 0; i < MESSAGES_PER_THREAD; i++) {
+		mpmcqueue_push(queue, MESSAGE(i));
+	}
+	return NULL;
+}
+
+void *consume_mpmcqueue(void *arg) {
+	bench_worker *worker = arg;
+	size_t i;
+	for (i = 0; i < MESSAGES_PER_THREAD; i++) {
+		worker->sum += (size_t)mpmcqueue_pop(queue);
+	}
+	return NULL;
+}
+
+void *produce_mpmcqueue_batched(void *arg) {
+	size_t i, k, pushed;
+	void *batch[BATCH];
+	(void)arg;
+	for (i = 0; i < MESSAGES_PER_THREAD; i += BATCH) {
+		for (k = 0; k < BATCH; k++) {
+			batch[k] = MESSAGE(i + k);
+		}
+		pushed = mpmcqueue_push_n(queue, batch, BATCH);
+		while (pushed < BATCH) {
+			sched_yield();
+			pushed += mpmcqueue_push_n(queue, batch + pushed, BATCH - pushed);
+		}
+	}
+	return NULL;
+}
+
+/* consumers may receive each other's share of the messages, so each just stops at its own count */
+void *consume_mpmcqueue_batched(void *arg) {
+	bench_worker *worker = arg;
+	size_t i, k, popped;
+	void *batch[BATCH];
+	for (i = 0; i < MESSAGES_PER_THREAD; i += popped) {
+		size_t wanted = MESSAGES_PER_THREAD - i < BATCH ? MESSAGES_PER_THREAD - i : BATCH;
+		while ((popped = mpmcqueue_pop_n(queue, batch, wanted)) == 0) {
+			sched_yield();
+		}
+		for (k = 0; k < popped; k++) {
+			worker->sum += (size_t)batch[k];
+		}
+	}
+	return NULL;
+}
+
+/* the deque is unbounded, so producers are held back at the same capacity to compare like with like */
+void *produce_locked_deque(void *arg) {
+	size_t i;
+	(void)arg;
+	for (i = 0; i < MESSAGES_PER_THREAD; i++) {
+		pthread_mutex_lock(&deque_lock);
+		while (deque_size(deque) >= CAPACITY) {
+			pthread_mutex_unlock(&deque_lock);
+			sched_yield();
+			pthread_mutex_lock(&deque_lock);
+		}
+		deque_enqueue(deque, MESSAGE(i));
+		pthread_mutex_unlock(&deque_lock);
+	}
+	return NULL;
+}
+
+void *consume_locked_deque(void *arg) {
+	bench_worker *worker = arg;
+	size_t i;
+	for (i = 0; i < MESSAGES_PER_THREAD; i++) {
+		void *el;
+		pthread_mutex_lock(&deque_lock);
+		while ((el = deque_dequeue(deque)) == NULL) {
+			pthread_mutex_unlock(&deque_lock);
+			sched_yield();
+			pthread_mutex_lock(&deque_lock);
+		}
+		pthread_mutex_unlock(&deque_lock);
+		worker->sum += (size_t)el;
+	}
+	return NULL;
+}
+
+/* runs as many producers as consumers, each of them sending or receiving MESSAGES_PER_THREAD messages */
+double run_threads(void *produce(void*), void *consume(void*), int threads) {
+	int i;
+	size_t sum = 0;
+	struct timespec start, end;
+	bench_worker *workers = malloc(2 * threads * sizeof *workers);
+	
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < 2 * threads; i++) {
+		workers[i].sum = 0;
+		pthread_create(&workers[i].thread, NULL, i % 2 == 0 ? produce : consume, &workers[i]);
+	}
+	for (i = 0; i < 2 * threads; i++) {
+		pthread_join(workers[i].thread, NULL);
+		sum += workers[i].sum;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	free(workers);
+	
+	if (sum != threads * ((size_t)MESSAGES_PER_THREAD * (MESSAGES_PER_THREAD + 1) / 2)) printf("messages were lost or duplicated!\n");
+	
+	/* millions of messages per second */
+	return threads * (double)MESSAGES_PER_THREAD / ((end.tv_sec - start.tv_sec) * 1e6 + (end.tv_nsec - start.tv_nsec) / 1e3);
+}
+
+int main(int argc, char **argv) {
+	int threads, max_threads = argc > 1 ? atoi(argv[1]) : 8;
+	
+	queue = alloc_mpmcqueue(CAPACITY);
+	deque = alloc_deque();
+	
+	printf("=== BENCHMARKING MPMC QUEUE === \n");
+	printf("%d messages per producer, as many consumers as producers, capacity of %d\n", MESSAGES_PER_THREAD, CAPACITY);
+	printf("producers\tmpmcqueue (Mmsgs/s)\tmpmcqueue, batches of %d (Mmsgs/s)\tdeque + mutex (Mmsgs/s)\n", BATCH);
+	for (threads = 1; threads <= max_threads; threads <<= 1) {
+		double single = run_threads(produce_mpmcqueue, consume_mpmcqueue, threads);
+		double batched = run_threads(produce_mpmcqueue_batched, consume_mpmcqueue_batched, threads);
+		double locked = run_threads(produce_locked_deque, consume_locked_deque, threads);
+		printf("%d\t\t%.2f\t\t\t%.2f\t\t\t\t\t%.2f\n", threads, single, batched, locked);
+	}
+	printf("=== BENCHMARKING DONE  === \n");
+	
+	dealloc_mpmcqueue(queue);
+	dealloc_deque(deque);
+	return 0;
+}
@@ -0,0 +1,85 @@
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <time.h>
+#include "pqueue.h"
+
+#define TIMERS (1 << 16)
+#define OPERATIONS (1 << 22)
+
+/* a scheduler's timer, carrying a handle for the intrusive pqueue */
+typedef struct timer {
+	size_t deadline;
+	size_t handle;
+} timer;
+
+static int timer_comparator(const void *a, const void *b) {
+	size_t x = ((const timer*)a)->deadline, y = ((const timer*)b)->deadline;
+	return (x > y) - (x < y);
+}
+
+double elapsed(struct timespec *start) {
+	struct timespec end;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/*
+ * Fires the earliest timer and rearms it, then moves another timer's deadline earlier (a decrease-key, as in
+ * dijkstra's algorithm), returning a checksum of the fired deadlines.
+ */
+size_t run(pqueue_ds *pq, timer *timers) {
+	size_t i, checksum = 0;
+	unsigned seed = 2463534242u;
+	
+	for (i = 0; i < TIMERS; i++) {
+		timers[i].deadline = i * 7919 % TIMERS;
+		pqueue_enqueue(pq, &timers[i]);
+	}
+	for (i = 0; i < OPERATIONS; i++) {
+		timer *fired = pqueue_dequeue(pq), *moved;
+		checksum += fired->deadline;
+		fired->deadline += TIMERS / 2 + (seed & (TIMERS - 1));
+		pqueue_enqueue(pq, fired);
+		
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		moved = &timers[seed & (TIMERS - 1)];
+		moved->deadline -= moved->deadline / 8;
+		pqueue_update(pq, moved);
+	}
+	while (pqueue_dequeue(pq) != NULL) {}
+	return checksum;
+}
+
+int main(void) {
+	size_t checksum, intrusive_checksum;
+	double indexed_seconds, intrusive_seconds;
+	struct timespec start;
+	timer *timers = malloc(TIMERS * sizeof *timers);
+	pqueue_ds *indexed = alloc_pqueue(timer_comparator);
+	pqueue_ds *intrusive = alloc_pqueue_intrusive(timer_comparator, offsetof(timer, handle));
+	
+	printf("=== BENCHMARKING PQUEUE === \n");
+	printf("%d timers, %d fire/rearm/decrease-key operations\n", TIMERS, OPERATIONS);
+	
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	checksum = run(indexed, timers);
+	indexed_seconds = elapsed(&start);
+	
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	intrusive_checksum = run(intrusive, timers);
+	intrusive_seconds = elapsed(&start);
+	
+	if (checksum != intrusive_checksum) printf("checksums differ!\n");
+	printf("pqueue with hashmap index:\t%.2f Mops/s\n", OPERATIONS / 1e6 / indexed_seconds);
+	printf("intrusive pqueue:\t\t%.2f Mops/s\n", OPERATIONS / 1e6 / intrusive_seconds);
+	printf("=== BENCHMARKING DONE  === \n");
+	
+	dealloc_pqueue(indexed);
+	dealloc_pqueue(intrusive);
+	free(timers);
+	return 0;
+}
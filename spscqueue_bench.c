@@ -0,0 +1,147 @@
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include "deque.h"
+#include "spscqueue.h"
+
+#define MESSAGES 20000000
+#define CAPACITY 4096
+#define BATCH 256
+
+/* messages are small integers disguised as pointers, never dereferenced */
+#define MESSAGE(i) ((void*)(size_t)((i) + 1))
+
+spscqueue_ds *queue = NULL;
+deque_ds *deque = NULL;
+pthread_mutex_t deque_lock = PTHREAD_MUTEX_INITIALIZER;
+size_t checksum = 0;
+
+void *produce_spscqueue(void *arg) {
+	size_t i;
+	(void)arg;
+	for (i = 0; i < MESSAGES; i++) {
+		while (!spscqueue_push(queue, MESSAGE(i))) {
+			sched_yield();
+		}
+	}
+	return NULL;
+}
+
+void *consume_spscqueue(void *arg) {
+	size_t i, sum = 0;
+	(void)arg;
+	for (i = 0; i < MESSAGES; i++) {
+		void *el;
+		while ((el = spscqueue_pop(queue)) == NULL) {
+			sched_yield();
+		}
+		sum += (size_t)el;
+	}
+	checksum = sum;
+	return NULL;
+}
+
+void *produce_spscqueue_batched(void *arg) {
+	size_t i, k, pushed;
+	void *batch[BATCH];
+	(void)arg;
+	for (i = 0; i < MESSAGES; i += BATCH) {
+		for (k = 0; k < BATCH; k++) {
+			batch[k] = MESSAGE(i + k);
+		}
+		pushed = spscqueue_push_n(queue, batch, BATCH);
+		while (pushed < BATCH) {
+			sched_yield();
+			pushed += spscqueue_push_n(queue, batch + pushed, BATCH - pushed);
+		}
+	}
+	return NULL;
+}
+
+void *consume_spscqueue_batched(void *arg) {
+	size_t i, k, popped, sum = 0;
+	void *batch[BATCH];
+	(void)arg;
+	for (i = 0; i < MESSAGES; i += popped) {
+		while ((popped = spscqueue_pop_n(queue, batch, BATCH)) == 0) {
+			sched_yield();
+		}
+		for (k = 0; k < popped; k++) {
+			sum += (size_t)batch[k];
+		}
+	}
+	checksum = sum;
+	return NULL;
+}
+
+/* the deque is unbounded, so the producer is held back at the same capacity to compare like with like */
+void *produce_locked_deque(void *arg) {
+	size_t i;
+	(void)arg;
+	for (i = 0; i < MESSAGES; i++) {
+		pthread_mutex_lock(&deque_lock);
+		while (deque_size(deque) == CAPACITY) {
+			pthread_mutex_unlock(&deque_lock);
+			sched_yield();
+			pthread_mutex_lock(&deque_lock);
+		}
+		deque_enqueue(deque, MESSAGE(i));
+		pthread_mutex_unlock(&deque_lock);
+	}
+	return NULL;
+}
+
+void *consume_locked_deque(void *arg) {
+	size_t i, sum = 0;
+	(void)arg;
+	for (i = 0; i < MESSAGES; i++) {
+		void *el;
+		pthread_mutex_lock(&deque_lock);
+		while ((el = deque_dequeue(deque)) == NULL) {
+			pthread_mutex_unlock(&deque_lock);
+			sched_yield();
+			pthread_mutex_lock(&deque_lock);
+		}
+		pthread_mutex_unlock(&deque_lock);
+		sum += (size_t)el;
+	}
+	checksum = sum;
+	return NULL;
+}
+
+double run_pair(void *produce(void*), void *consume(void*)) {
+	pthread_t producer, consumer;
+	struct timespec start, end;
+	
+	checksum = 0;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	pthread_create(&producer, NULL, produce, NULL);
+	pthread_create(&consumer, NULL, consume, NULL);
+	pthread_join(producer, NULL);
+	pthread_join(consumer, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	
+	if (checksum != (size_t)MESSAGES * (MESSAGES + 1) / 2) printf("messages were lost or duplicated!\n");
+	
+	/* millions of messages per second */
+	return MESSAGES / ((end.tv_sec - start.tv_sec) * 1e6 + (end.tv_nsec - start.tv_nsec) / 1e3);
+}
+
+int main(void) {
+	queue = alloc_spscqueue(CAPACITY);
+	deque = alloc_deque();
+	
+	printf("=== BENCHMARKING SPSC QUEUE === \n");
+	printf("%d messages from one producer to one consumer, capacity of %d\n", MESSAGES, CAPACITY);
+	printf("spscqueue:\t\t%.2f Mmsgs/s\n", run_pair(produce_spscqueue, consume_spscqueue));
+	printf("spscqueue (batches of %d):\t%.2f Mmsgs/s\n", BATCH, run_pair(produce_spscqueue_batched, consume_spscqueue_batched));
+	printf("deque + mutex:\t\t%.2f Mmsgs/s\n", run_pair(produce_locked_deque, consume_locked_deque));
+	printf("=== BENCHMARKING DONE  === \n");
+	
+	dealloc_spscqueue(queue);
+	dealloc_deque(deque);
+	return 0;
+}
@@ -4,16 +4,18 @@
 
 #define DS_NAME "avltree"
 #include "err/ds_assert.h"
+#include "ds_allocator.h"
 #include "avltree.h"
 
 #define NODE_HEIGHT(node) (((node) == NULL) ? (-1) : (node->height))
 #define MAX(a, b) (((a) > (b)) ? (a) : (b))
 
 typedef struct avltree_node avltree_node;
-static void avltree_delete_subtree(avltree_node *root);
+static void avltree_delete_subtree(avltree_ds *const this, avltree_node *root);
 
 struct avltree_ds {
 	int (*compare)(const void*, const void*);
+	ds_allocator allocator;
 	struct avltree_node {
 		void *val;
 		int height;
@@ -22,8 +24,8 @@ struct avltree_ds {
 	} *root;
 };
 
-static avltree_node *alloc_avltree_node(void *val) {
-	avltree_node *node = malloc(sizeof *node);
+static avltree_node *alloc_avltree_node(avltree_ds *const this, void *val) {
+	avltree_node *node = ds_alloc(&this->allocator, sizeof *node);
 	if (node != NULL) {
 		node->val = val;
 		node->height = 0;
@@ -34,24 +36,32 @@ static avltree_node *alloc_avltree_node(void *val) {
 }
 
 avltree_ds *alloc_avltree(int comparator(const void*, const void*)) {
-	avltree_ds *this = malloc(sizeof *this);
-	DS_ASSERT(this != NULL, "failed to allocate memory for new " DS_NAME);
+	return alloc_avltree_with(comparator, NULL);
+}
 
+avltree_ds *alloc_avltree_with(int comparator(const void*, const void*), const ds_allocator *allocator) {
+	avltree_ds *this;
+	if (allocator == NULL) allocator = &ds_default_allocator;
+	
+	this = ds_alloc(allocator, sizeof *this);
+	DS_ASSERT(this != NULL, "failed to allocate memory for new " DS_NAME);
+	
+	this->allocator = *allocator;
 	this->compare = comparator;
 	this->root = NULL;
 	return this;
 }
 
 void dealloc_avltree(avltree_ds *const this) {
-	avltree_delete_subtree(this->root);
-	free(this);
+	avltree_delete_subtree(this, this->root);
+	ds_free(&this->allocator, this, sizeof *this);
 }
 
-static void avltree_delete_subtree(avltree_node *root) {
+static void avltree_delete_subtree(avltree_ds *const this, avltree_node *root) {
 	if (root != NULL) {
-		avltree_delete_subtree(root->left);
-		avltree_delete_subtree(root->right);
-		free(root);
+		avltree_delete_subtree(this, root->left);
+		avltree_delete_subtree(this, root->right);
+		ds_free(&this->allocator, root, sizeof *root);
 	}
 }
 
@@ -108,7 +118,7 @@ static int avltree_insert_helper(avltree_ds *const this, avltree_node **traversa
 	
 	/* base case */
 	if (*traversal == NULL) {
-		*traversal = alloc_avltree_node(val);
+		*traversal = alloc_avltree_node(this, val);
 		DS_ASSERT(*traversal != NULL, "failed to allocate new memory for new node");
 		return 1;
 	}
@@ -166,13 +176,13 @@ static int avltree_remove_helper(avltree_ds *const this, avltree_node **traversa
 			(*traversal)->val = minimum->val;
 			return avltree_remove_helper(this, &(*traversal)->right, minimum->val);
 		} else if ((*traversal)->left == NULL && (*traversal)->right == NULL) { /* has no children: leaf node */
-			free(*traversal);
+			ds_free(&this->allocator, *traversal, sizeof **traversal);
 			*traversal = NULL;
 		} else { /* has either left or right child */
 			avltree_node *connection = ((*traversal)->left != NULL) ? (*traversal)->left : (*traversal)->right;
 			avltree_node *target = *traversal;
 			*traversal = connection;	/* analogous to assigning connection to either parent->left or parent->right */
-			free(target);
+			ds_free(&this->allocator, target, sizeof *target);
 		}
 		
 	}
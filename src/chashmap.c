@@ -0,0 +1,285 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include "hashmap.h"
+
+#define DS_NAME "chashmap"
+#include "err/ds_assert.h"
+#include "chashmap.h"
+
+#define INITIAL_CAPACITY 16
+#define DEFAULT_SEGMENTS 64
+#define CACHE_LINE 64
+
+/* probe sequence lengths are stored biased by one so that zero can mark a vacant slot */
+#define PSL_VACANT 0
+#define PSL_SATURATED UCHAR_MAX
+#define PSL_BYTE(psl) ((psl) < PSL_SATURATED - 1 ? (unsigned char)((psl) + 1) : PSL_SATURATED)
+
+/*
+ * Readers race with writers by design, so every access to something a reader may look at is atomic. Entries are
+ * written before the metadata byte that makes them visible is released, hence a reader that acquires an occupied
+ * metadata byte never sees an entry that was never written.
+ */
+#define LOAD(ptr) __atomic_load_n(ptr, __ATOMIC_RELAXED)
+#define STORE(ptr, val) __atomic_store_n(ptr, val, __ATOMIC_RELAXED)
+#define LOAD_ACQUIRE(ptr) __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+#define STORE_RELEASE(ptr, val) __atomic_store_n(ptr, val, __ATOMIC_RELEASE)
+
+#define SEGMENT_OF(this, hash) (&(this)->segments[(((hash) * 2654435761u) >> 20) & (this)->segment_mask].segment)
+
+typedef struct chashmap_table {
+	size_t size;
+	size_t capacity;
+	size_t load_factor;
+	hashmap_entry *table;
+	unsigned char *psl;
+	struct chashmap_table *retired;	/* table this one replaced, kept for readers that may still be searching it */
+} chashmap_table;
+
+typedef struct chashmap_segment {
+	pthread_mutex_t lock;		/* serializes writers */
+	unsigned long sequence;		/* odd while a writer is modifying the segment */
+	chashmap_table *current;
+} chashmap_segment;
+
+struct chashmap_ds {
+	size_t (*hash)(const void*);
+	int (*is_equals)(const void*, const void*);
+	size_t segment_mask;
+	
+	/* segments are padded to their own cache lines so that writers of neighbouring segments don't contend */
+	union chashmap_padded_segment {
+		chashmap_segment segment;
+		char padding[((sizeof(chashmap_segment) + CACHE_LINE - 1) / CACHE_LINE) * CACHE_LINE];
+	} *segments;
+};
+
+static chashmap_table *alloc_chashmap_table(size_t capacity) {
+	chashmap_table *table = malloc(sizeof *table);
+	DS_ASSERT(table != NULL, "failed to allocate memory for a segment's table");
+	
+	table->size = 0;
+	table->capacity = capacity;
+	table->load_factor = (capacity * 3) >> 2;
+	table->retired = NULL;
+	table->table = malloc(capacity * sizeof *table->table);
+	DS_ASSERT(table->table != NULL, "failed to allocate memory for a segment's entries");
+	
+	table->psl = calloc(capacity, sizeof *table->psl);
+	DS_ASSERT(table->psl != NULL, "failed to allocate memory for a segment's probe lengths");
+	return table;
+}
+
+chashmap_ds *alloc_chashmap(size_t hash(const void*), int is_equals(const void*, const void*), size_t segments) {
+	size_t i, count = 1;
+	chashmap_ds *this = malloc(sizeof *this);
+	DS_ASSERT(this != NULL, "failed to allocate memory for new " DS_NAME);
+	
+	while (count < (segments != 0 ? segments : DEFAULT_SEGMENTS)) {
+		count <<= 1;
+	}
+	
+	this->hash = hash;
+	this->is_equals = is_equals;
+	this->segment_mask = count - 1;
+	this->segments = malloc(count * sizeof *this->segments);
+	DS_ASSERT(this->segments != NULL, "failed to allocate memory for the " DS_NAME "'s segments");
+	
+	for (i = 0; i < count; i++) {
+		chashmap_segment *segment = &this->segments[i].segment;
+		DS_ASSERT(pthread_mutex_init(&segment->lock, NULL) == 0, "failed to initialize a segment's lock");
+		segment->sequence = 0;
+		segment->current = alloc_chashmap_table(INITIAL_CAPACITY);
+	}
+	return this;
+}
+
+void dealloc_chashmap(chashmap_ds *const this) {
+	size_t i;
+	for (i = 0; i <= this->segment_mask; i++) {
+		chashmap_segment *segment = &this->segments[i].segment;
+		chashmap_table *retired, *table = segment->current;
+		while (table != NULL) {
+			retired = table->retired;
+			free(table->table);
+			free(table->psl);
+			free(table);
+			table = retired;
+		}
+		pthread_mutex_destroy(&segment->lock);
+	}
+	free(this->segments);
+	free(this);
+}
+
+/* exact probe sequence length of an occupied slot, only long chains need to consult the cached hash */
+static size_t chashmap_slot_psl(const chashmap_table *const table, size_t i, unsigned char psl) {
+	if (psl != PSL_SATURATED) return psl - 1;
+	return (i - LOAD(&table->table[i].hash)) & (table->capacity - 1);
+}
+
+/* same robin-hood insertion as the hashmap's, with every store visible to readers made atomic */
+static void *chashmap_table_put(chashmap_ds *const this, chashmap_table *const table, hashmap_entry insertion, int unique) {
+	int displaced = unique;
+	size_t dist, occupant_dist, mask = table->capacity - 1;
+	size_t i = insertion.hash & mask;
+	
+	for (dist = 0; table->psl[i] != PSL_VACANT; i = (i+1) & mask, dist++) {
+		hashmap_entry *occupant = &table->table[i];
+		if (!displaced && occupant->hash == insertion.hash && this->is_equals(occupant->key, insertion.key)) {
+			void *oldval = occupant->value;
+			STORE(&occupant->value, insertion.value);
+			return oldval;
+		}
+		
+		occupant_dist = chashmap_slot_psl(table, i, table->psl[i]);
+		if (dist > occupant_dist) {
+			/* swap */
+			hashmap_entry temp = *occupant;
+			STORE(&occupant->key, insertion.key);
+			STORE(&occupant->value, insertion.value);
+			STORE(&occupant->hash, insertion.hash);
+			STORE_RELEASE(&table->psl[i], PSL_BYTE(dist));
+			
+			/* find new spot */
+			insertion = temp;
+			dist = occupant_dist;
+			displaced = 1;
+		}
+	}
+	
+	STORE(&table->table[i].key, insertion.key);
+	STORE(&table->table[i].value, insertion.value);
+	STORE(&table->table[i].hash, insertion.hash);
+	STORE_RELEASE(&table->psl[i], PSL_BYTE(dist));
+	table->size++;
+	return NULL;
+}
+
+/* called with the segment locked and a write in progress */
+static void chashmap_grow(chashmap_ds *const this, chashmap_segment *const segment) {
+	size_t i;
+	chashmap_table *old = segment->current;
+	chashmap_table *grown = alloc_chashmap_table(old->capacity << 1);
+	
+	/* nobody can see the grown table before it's published, so it's filled without further ado */
+	for (i = 0; i < old->capacity; i++) {
+		if (old->psl[i] != PSL_VACANT) chashmap_table_put(this, grown, old->table[i], 1);
+	}
+	grown->retired = old;
+	STORE_RELEASE(&segment->current, grown);
+}
+
+static void chashmap_write_begin(chashmap_segment *const segment) {
+	pthread_mutex_lock(&segment->lock);
+	STORE(&segment->sequence, segment->sequence + 1);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void chashmap_write_end(chashmap_segment *const segment) {
+	STORE_RELEASE(&segment->sequence, segment->sequence + 1);
+	pthread_mutex_unlock(&segment->lock);
+}
+
+void *chashmap_put(chashmap_ds *const this, void *key, void *value) {
+	void *oldval;
+	hashmap_entry insertion;
+	chashmap_segment *segment;
+	
+	insertion.key = key;
+	insertion.value = value;
+	insertion.hash = this->hash(key);
+	segment = SEGMENT_OF(this, insertion.hash);
+	
+	chashmap_write_begin(segment);
+	oldval = chashmap_table_put(this, segment->current, insertion, 0);
+	if (segment->current->size >= segment->current->load_factor) chashmap_grow(this, segment);
+	chashmap_write_end(segment);
+	return oldval;
+}
+
+/*
+ * Searches a table that writers may be modifying right now. Whatever is found only counts if the segment's
+ * sequence didn't move in the meantime, and the probe is bounded so that a torn view can't keep it going.
+ */
+static hashmap_entry *chashmap_table_search(chashmap_ds *const this, chashmap_table *const table, const void *key, size_t hash) {
+	size_t dist, mask = table->capacity - 1;
+	size_t i = hash & mask;
+	unsigned char psl;
+	
+	for (dist = 0; dist <= mask && (psl = LOAD_ACQUIRE(&table->psl[i])) != PSL_VACANT; i = (i+1) & mask, dist++) {
+		/* the key would have displaced any occupant that is closer to its home than we are */
+		if (psl != PSL_SATURATED && (size_t)(psl - 1) < dist) {
+			break;
+		}
+		if (LOAD(&table->table[i].hash) == hash && this->is_equals(LOAD(&table->table[i].key), key)) {
+			return &table->table[i];
+		}
+	}
+	return NULL;
+}
+
+void *chashmap_get(chashmap_ds *const this, void *key) {
+	size_t hash = this->hash(key);
+	chashmap_segment *segment = SEGMENT_OF(this, hash);
+	unsigned long sequence;
+	void *value;
+	
+	for (;;) {
+		hashmap_entry *entry;
+		
+		sequence = LOAD_ACQUIRE(&segment->sequence);
+		if (sequence & 1) {
+			sched_yield();
+			continue;
+		}
+		
+		entry = chashmap_table_search(this, LOAD_ACQUIRE(&segment->current), key, hash);
+		value = entry != NULL ? LOAD(&entry->value) : NULL;
+		
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (LOAD(&segment->sequence) == sequence) return value;
+	}
+}
+
+void *chashmap_remove(chashmap_ds *const this, void *key) {
+	void *oldval = NULL;
+	size_t hash = this->hash(key);
+	chashmap_segment *segment = SEGMENT_OF(this, hash);
+	hashmap_entry *entry;
+	
+	chashmap_write_begin(segment);
+	entry = chashmap_table_search(this, segment->current, key, hash);
+	if (entry != NULL) {
+		chashmap_table *table = segment->current;
+		size_t next, mask = table->capacity - 1;
+		size_t i = (size_t)(entry - table->table);
+		oldval = entry->value;
+		
+		/* engage backward shifting */
+		for (next = (i+1) & mask; table->psl[next] > PSL_BYTE(0); i = next, next = (next+1) & mask) {
+			STORE(&table->table[i].key, table->table[next].key);
+			STORE(&table->table[i].value, table->table[next].value);
+			STORE(&table->table[i].hash, table->table[next].hash);
+			STORE_RELEASE(&table->psl[i], PSL_BYTE(chashmap_slot_psl(table, next, table->psl[next]) - 1));
+		}
+		STORE_RELEASE(&table->psl[i], PSL_VACANT);
+		table->size--;
+	}
+	chashmap_write_end(segment);
+	return oldval;
+}
+
+size_t chashmap_size(chashmap_ds *const this) {
+	size_t i, size = 0;
+	for (i = 0; i <= this->segment_mask; i++) {
+		chashmap_segment *segment = &this->segments[i].segment;
+		pthread_mutex_lock(&segment->lock);
+		size += segment->current->size;
+		pthread_mutex_unlock(&segment->lock);
+	}
+	return size;
+}
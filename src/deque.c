@@ -1,98 +1,717 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define DS_NAME "deque"
 #include "err/ds_assert.h"
+#include "ds_allocator.h"
 #include "deque.h"
 
+#define INITIAL_CAPACITY 16
+
+/* elements per block of the block engine, a block of pointers fills a 4K page on 64-bit platforms */
+#define BLOCK_SHIFT 9
+#define BLOCK_SIZE ((size_t)1 << BLOCK_SHIFT)
+#define INITIAL_BLOCK_CAPACITY 8
+#define BLOCK_BYTES (BLOCK_SIZE * sizeof(void*))
+/* spilled blocks are read back this many at a time, the spill file's buffer holds as many */
+#define READAHEAD_BLOCKS 16
+#define NO_SLOT ((size_t)-1)
+/* blocks that n elements can span when they don't start at the left of a block */
+#define BLOCKS_FOR(n) (((n) + BLOCK_SIZE - 1) / BLOCK_SIZE + 1)
+
 struct deque_ds {
-	size_t head;
+	deque_engine engine;
+	size_t head;			/* slot of the leftmost element: in the array, or in the leftmost block */
 	size_t tail;
 	size_t len;
 	size_t capacity;
+	size_t reserved;		/* capacity in elements the deque doesn't shrink below by itself */
 	void **deque;
+	void ***blocks;			/* circular map of blocks, the ones in use start at first_block */
+	size_t block_capacity;
+	size_t first_block;
+	size_t used_blocks;
+	void **spare;			/* most recently emptied block, kept so that a deque hovering at a block boundary doesn't churn */
+	FILE *spill;			/* temporary file blocks are spilled to, NULL unless the deque has a budget */
+	size_t budget;			/* most blocks kept in memory, 0 for no budget */
+	size_t readahead;		/* blocks read back from the spill file at once */
+	size_t spill_first;		/* spilled blocks counted from the leftmost block, none if both are equal */
+	size_t spill_end;
+	size_t spill_slot;		/* slot of the spill file holding the block at spill_first, the others follow it */
+	long spill_position;	/* offset the spill file is at, -1 if unknown */
+	int spill_writing;
+	void **window;			/* copy of a spilled block that was accessed by index */
+	size_t window_slot;
+	int window_dirty;
+	ds_allocator allocator;
 };
 
 deque_ds *alloc_deque(void) {
-	deque_ds *this = malloc(sizeof *this);
+	return alloc_deque_with(DEQUE_RING, NULL);
+}
+
+deque_ds *alloc_deque_engine(deque_engine engine) {
+	return alloc_deque_with(engine, NULL);
+}
+
+deque_ds *alloc_deque_with(deque_engine engine, const ds_allocator *allocator) {
+	deque_ds *this;
+	if (allocator == NULL) allocator = &ds_default_allocator;
+	
+	this = ds_alloc(allocator, sizeof *this);
 	DS_ASSERT(this != NULL, "failed to allocate memory for new " DS_NAME);
 	
+	this->allocator = *allocator;
+	this->engine = engine;
 	this->head = 0;
 	this->tail = 0;
 	this->len = 0;
-	this->capacity = 16;
-	this->deque = malloc(16 * sizeof *this->deque);
+	this->capacity = 0;
+	this->reserved = 0;
+	this->deque = NULL;
+	this->blocks = NULL;
+	this->block_capacity = 0;
+	this->first_block = 0;
+	this->used_blocks = 0;
+	this->spare = NULL;
+	this->spill = NULL;
+	this->budget = 0;
+	this->readahead = 0;
+	this->spill_first = 0;
+	this->spill_end = 0;
+	this->spill_slot = 0;
+	this->spill_position = -1;
+	this->spill_writing = 0;
+	this->window = NULL;
+	this->window_slot = NO_SLOT;
+	this->window_dirty = 0;
+	
+	if (engine == DEQUE_BLOCKS) {
+		this->block_capacity = INITIAL_BLOCK_CAPACITY;
+		this->blocks = ds_alloc(allocator, INITIAL_BLOCK_CAPACITY * sizeof *this->blocks);
+		DS_ASSERT(this->blocks != NULL, "failed to allocate memory for the " DS_NAME "'s blocks");
+	} else {
+		this->capacity = INITIAL_CAPACITY;
+		this->deque = ds_alloc(allocator, INITIAL_CAPACITY * sizeof *this->deque);
+		DS_ASSERT(this->deque != NULL, "failed to allocate memory for the " DS_NAME "'s array");
+	}
 	return this;
 }
 
 void dealloc_deque(deque_ds *const this) {
-	free(this->deque);
-	free(this);
+	size_t i;
+	for (i = 0; i < this->used_blocks; i++) {
+		ds_free(&this->allocator, this->blocks[(this->first_block + i) & (this->block_capacity - 1)], BLOCK_SIZE * sizeof **this->blocks);
+	}
+	ds_free(&this->allocator, this->spare, BLOCK_SIZE * sizeof *this->spare);
+	ds_free(&this->allocator, this->window, BLOCK_BYTES);
+	if (this->spill != NULL) fclose(this->spill);
+	ds_free(&this->allocator, this->blocks, this->block_capacity * sizeof *this->blocks);
+	ds_free(&this->allocator, this->deque, this->capacity * sizeof *this->deque);
+	ds_free(&this->allocator, this, sizeof *this);
 }
 
-static void deque_resize(deque_ds *const this) {
+/*** RING ENGINE - BEGIN ***/
+
+static void deque_resize(deque_ds *const this, size_t capacity) {
 	size_t i_1, i_2, len = this->len, old_capacity = this->capacity;
 	
 	void **new_deque, **old_deque = this->deque;
-	this->capacity <<= 1;
-	new_deque = malloc(this->capacity * sizeof *new_deque);
-	DS_ASSERT(new_deque != NULL, "failed to allocate memory for expanding the " DS_NAME);
 	
-	for (i_1 = this->head, i_2 = 0; i_2 < len; i_1 = (i_1 + 1) & (old_capacity - 1), i_2++) {
-		new_deque[i_2] = old_deque[i_1];
+	if (capacity < old_capacity) {
+		/*
+		 * Shrinking compacts the elements to the front in place and gives the rest back, so that draining a
+		 * large deque doesn't allocate and fault in ever smaller copies of it. A wrapped second part is moved
+		 * behind where the first part will go before the first part is, as it may lie where the first goes.
+		 */
+		size_t first = this->head + len > old_capacity ? old_capacity - this->head : len;
+		memmove(old_deque + first, old_deque, (len - first) * sizeof *old_deque);
+		memmove(old_deque, old_deque + this->head, first * sizeof *old_deque);
+		new_deque = ds_realloc(&this->allocator, old_deque, old_capacity * sizeof *old_deque, capacity * sizeof *new_deque);
+		DS_ASSERT(new_deque != NULL, "failed to allocate memory for shrinking the " DS_NAME);
+	} else {
+		new_deque = ds_alloc(&this->allocator, capacity * sizeof *new_deque);
+		DS_ASSERT(new_deque != NULL, "failed to allocate memory for expanding the " DS_NAME);
+		
+		for (i_1 = this->head, i_2 = 0; i_2 < len; i_1 = (i_1 + 1) & (old_capacity - 1), i_2++) {
+			new_deque[i_2] = old_deque[i_1];
+		}
+		
+		ds_free(&this->allocator, old_deque, old_capacity * sizeof *old_deque);
 	}
-	
-	free(old_deque);
+	this->capacity = capacity;
 	this->deque = new_deque;
 	this->head = 0;
-	this->tail = old_capacity;
+	this->tail = len & (capacity - 1);
 }
 
-void deque_pushleft(deque_ds *const this, void *el) {
-	if (this->len == this->capacity) deque_resize(this);
+/*
+ * Halves the array once it's only a quarter full, so that it takes as many pops to shrink it again as it takes
+ * pushes to grow it back, and a deque hovering around a power of two doesn't resize back and forth.
+ */
+static void ring_trim(deque_ds *const this) {
+	size_t half = this->capacity >> 1;
+	if (this->len <= this->capacity >> 2 && half >= INITIAL_CAPACITY && half >= this->reserved) deque_resize(this, half);
+}
+
+static void ring_pushleft(deque_ds *const this, void *el) {
+	if (this->len == this->capacity) deque_resize(this, this->capacity << 1);
 	this->head = (this->head - 1) & (this->capacity - 1);
 	this->deque[this->head] = el;
 	this->len++;
 }
 
-/* analogous to enqueue and stack push */
-void deque_pushright(deque_ds *const this, void *el) {
-	if (this->len == this->capacity) deque_resize(this);
+static void ring_pushright(deque_ds *const this, void *el) {
+	if (this->len == this->capacity) deque_resize(this, this->capacity << 1);
 	this->deque[this->tail] = el;
 	this->tail = (this->tail + 1) & (this->capacity - 1);
 	this->len++;
 }
 
-/* analogous to dequeue */
-void *deque_popleft(deque_ds *const this) {
+static void *ring_popleft(deque_ds *const this) {
 	void *el;
 	if (this->len == 0) return NULL;
 	el = this->deque[this->head];
 	this->deque[this->head] = NULL;
 	this->head = (this->head + 1) & (this->capacity - 1);
 	this->len--;
+	ring_trim(this);
 	return el;
 }
 
-/* analogus to stack pop */
-void *deque_popright(deque_ds *const this) {
+static void *ring_popright(deque_ds *const this) {
 	void *el;
 	if (this->len == 0) return NULL;
 	this->tail = (this->tail - 1) & (this->capacity - 1);
 	el = this->deque[this->tail];
 	this->deque[this->tail] = NULL;
 	this->len--;
+	ring_trim(this);
+	return el;
+}
+
+/* the array is grown once to fit all elements, which are then copied in at most two pieces around the wraparound */
+static void ring_pushright_n(deque_ds *const this, void *const *els, size_t n) {
+	size_t first, capacity = this->capacity;
+	while (capacity - this->len < n) {
+		capacity <<= 1;
+	}
+	if (capacity != this->capacity) deque_resize(this, capacity);
+	
+	first = n < this->capacity - this->tail ? n : this->capacity - this->tail;
+	memcpy(this->deque + this->tail, els, first * sizeof *els);
+	memcpy(this->deque, els + first, (n - first) * sizeof *els);
+	this->tail = (this->tail + n) & (this->capacity - 1);
+	this->len += n;
+}
+
+static size_t ring_popleft_n(deque_ds *const this, void **out, size_t n) {
+	size_t first, count = n < this->len ? n : this->len, capacity = this->capacity;
+	first = count < this->capacity - this->head ? count : this->capacity - this->head;
+	memcpy(out, this->deque + this->head, first * sizeof *out);
+	memcpy(out + first, this->deque, (count - first) * sizeof *out);
+	this->head = (this->head + count) & (this->capacity - 1);
+	this->len -= count;
+	
+	/* however many halvings a large pop calls for, the array is only copied once */
+	while (capacity >> 1 >= INITIAL_CAPACITY && this->len <= capacity >> 2 && capacity >> 1 >= this->reserved) {
+		capacity >>= 1;
+	}
+	if (capacity != this->capacity) deque_resize(this, capacity);
+	return count;
+}
+
+/*** RING ENGINE - END ***/
+
+/*** BLOCK ENGINE - BEGIN ***/
+
+/* the block holding the element at the given position, counted from the leftmost slot of the leftmost block */
+#define BLOCK_AT(this, pos) ((this)->blocks[((this)->first_block + ((pos) >> BLOCK_SHIFT)) & ((this)->block_capacity - 1)])
+
+static void **blocks_take(deque_ds *const this) {
+	void **block = this->spare;
+	if (block != NULL) {
+		this->spare = NULL;
+		return block;
+	}
+	block = ds_alloc(&this->allocator, BLOCK_SIZE * sizeof *block);
+	DS_ASSERT(block != NULL, "failed to allocate memory for a block of the " DS_NAME);
+	return block;
+}
+
+static void blocks_give(deque_ds *const this, void **block) {
+	if (this->spare == NULL) {
+		this->spare = block;
+	} else {
+		ds_free(&this->allocator, block, BLOCK_SIZE * sizeof *block);
+	}
+}
+
+/* only the map of blocks is ever copied, a pointer per block rather than per element */
+static void blocks_resize_map(deque_ds *const this, size_t capacity) {
+	size_t i, old_capacity = this->block_capacity;
+	void ***old_blocks = this->blocks;
+	
+	this->block_capacity = capacity;
+	this->blocks = ds_alloc(&this->allocator, this->block_capacity * sizeof *this->blocks);
+	DS_ASSERT(this->blocks != NULL, "failed to allocate memory for expanding the " DS_NAME "'s blocks");
+	
+	for (i = 0; i < this->used_blocks; i++) {
+		this->blocks[i] = old_blocks[(this->first_block + i) & (old_capacity - 1)];
+	}
+	ds_free(&this->allocator, old_blocks, old_capacity * sizeof *old_blocks);
+	this->first_block = 0;
+}
+
+/* halves the map once it's only a quarter full, like the ring engine's array */
+static void blocks_trim_map(deque_ds *const this) {
+	size_t half = this->block_capacity >> 1;
+	if (this->used_blocks <= this->block_capacity >> 2 && half >= INITIAL_BLOCK_CAPACITY && half >= BLOCKS_FOR(this->reserved)) {
+		blocks_resize_map(this, half);
+	}
+}
+
+/*
+ * Spilling: the blocks between the leftmost and the rightmost one may be written to a temporary file, leaving
+ * their entries of the map NULL. Spilled blocks are always consecutive, from spill_first up to spill_end, and
+ * so are their slots in the file. Blocks are spilled at spill_end, so the file is appended to in the order
+ * the deque holds them, and read back from spill_first as the left end catches up, readahead at a time.
+ * Blocks pushed to the left pile up in front of spill_first instead, so they're spilled there once spill_end
+ * reached the rightmost block, into the slots before spill_slot.
+ */
+
+static void spill_transfer(deque_ds *const this, size_t slot, void **block, int writing) {
+	long offset = (long)(slot * BLOCK_BYTES);
+	
+	/* stdio requires a seek between reads and writes anyway, other seeks would only discard its buffer */
+	if (offset != this->spill_position || writing != this->spill_writing) {
+		DS_ASSERT(fseek(this->spill, offset, SEEK_SET) == 0, "failed to seek the " DS_NAME "'s spill file");
+		this->spill_writing = writing;
+	}
+	if (writing) {
+		DS_ASSERT(fwrite(block, BLOCK_BYTES, 1, this->spill) == 1, "failed to spill a block of the " DS_NAME);
+	} else {
+		DS_ASSERT(fread(block, BLOCK_BYTES, 1, this->spill) == 1, "failed to read back a block of the " DS_NAME);
+	}
+	this->spill_position = offset + (long)BLOCK_BYTES;
+}
+
+/* the file is rewound once nothing is spilled anymore, it only grows while the deque stays over budget */
+static void spill_reset(deque_ds *const this) {
+	this->spill_first = 0;
+	this->spill_end = 0;
+	this->spill_slot = 0;
+	this->window_slot = NO_SLOT;
+}
+
+static void spill_out_right(deque_ds *const this) {
+	size_t index = (this->first_block + this->spill_end) & (this->block_capacity - 1);
+	spill_transfer(this, this->spill_slot + (this->spill_end - this->spill_first), this->blocks[index], 1);
+	blocks_give(this, this->blocks[index]);
+	this->blocks[index] = NULL;
+	this->spill_end++;
+}
+
+/* moves the spilled blocks' slots up the file to free the ones before them, at least as many as are spilled */
+static void spill_make_room(deque_ds *const this) {
+	size_t i, spilled = this->spill_end - this->spill_first;
+	size_t shift = spilled > READAHEAD_BLOCKS ? spilled : READAHEAD_BLOCKS;
+	void **block = blocks_take(this);
+	
+	if (this->window_slot != NO_SLOT && this->window_dirty) spill_transfer(this, this->window_slot, this->window, 1);
+	this->window_slot = NO_SLOT;
+	this->window_dirty = 0;
+	
+	for (i = spilled; i-- > 0;) {
+		spill_transfer(this, this->spill_slot + i, block, 0);
+		spill_transfer(this, this->spill_slot + i + shift, block, 1);
+	}
+	blocks_give(this, block);
+	this->spill_slot += shift;
+}
+
+static void spill_out_left(deque_ds *const this) {
+	size_t index;
+	if (this->spill_slot == 0) spill_make_room(this);
+	
+	this->spill_first--;
+	this->spill_slot--;
+	index = (this->first_block + this->spill_first) & (this->block_capacity - 1);
+	spill_transfer(this, this->spill_slot, this->blocks[index], 1);
+	blocks_give(this, this->blocks[index]);
+	this->blocks[index] = NULL;
+}
+
+/* reads back the spilled block at the given position, which must be the first or the last spilled one */
+static void spill_in(deque_ds *const this, size_t position) {
+	size_t slot = this->spill_slot + (position - this->spill_first);
+	void **block = blocks_take(this);
+	
+	if (slot == this->window_slot) {
+		memcpy(block, this->window, BLOCK_BYTES);
+		this->window_slot = NO_SLOT;
+	} else {
+		spill_transfer(this, slot, block, 0);
+	}
+	this->blocks[(this->first_block + position) & (this->block_capacity - 1)] = block;
+}
+
+/* reads back a readahead of blocks, fewer if more would exceed the budget, but at least the leftmost one */
+static void spill_read_left(deque_ds *const this) {
+	size_t n = this->spill_end - this->spill_first;
+	size_t resident = this->used_blocks - n;
+	size_t room = resident < this->budget ? this->budget - resident : 1;
+	if (n > this->readahead) n = this->readahead;
+	if (this->budget != 0 && n > room) n = room;
+	
+	while (n-- > 0) {
+		spill_in(this, this->spill_first);
+		this->spill_first++;
+		this->spill_slot++;
+	}
+	if (this->spill_first == this->spill_end) spill_reset(this);
+}
+
+static void spill_read_right(deque_ds *const this) {
+	spill_in(this, this->spill_end - 1);
+	this->spill_end--;
+	if (this->spill_first == this->spill_end) spill_reset(this);
+}
+
+/*
+ * Spills the blocks furthest from the left end first, then those the left end pushed in front of them, only
+ * ever keeping the leftmost and rightmost blocks in memory.
+ */
+static void spill_enforce(deque_ds *const this) {
+	size_t resident = this->used_blocks - (this->spill_end - this->spill_first);
+	if (this->budget == 0 || resident <= this->budget) return;
+	
+	if (this->spill_first == this->spill_end) {
+		size_t excess = resident - this->budget;
+		this->spill_first = this->used_blocks > excess + 1 ? this->used_blocks - 1 - excess : 1;
+		this->spill_end = this->spill_first;
+	}
+	while (resident > this->budget && this->spill_end + 1 < this->used_blocks) {
+		spill_out_right(this);
+		resident--;
+	}
+	while (resident > this->budget && this->spill_first > 1) {
+		spill_out_left(this);
+		resident--;
+	}
+	if (this->spill_first == this->spill_end) spill_reset(this);
+}
+
+/* the block at the given position counted from the leftmost block, or a copy of it if it's spilled */
+static void **blocks_get(deque_ds *const this, size_t position, int writing) {
+	void **block = this->blocks[(this->first_block + position) & (this->block_capacity - 1)];
+	size_t slot;
+	if (block != NULL) return block;
+	
+	slot = this->spill_slot + (position - this->spill_first);
+	if (slot != this->window_slot) {
+		if (this->window_slot != NO_SLOT && this->window_dirty) spill_transfer(this, this->window_slot, this->window, 1);
+		spill_transfer(this, slot, this->window, 0);
+		this->window_slot = slot;
+		this->window_dirty = 0;
+	}
+	if (writing) this->window_dirty = 1;
+	return this->window;
+}
+
+/* an emptied deque gives all of its blocks back, so that it starts over at the left of a fresh block */
+static void blocks_drain(deque_ds *const this) {
+	while (this->used_blocks > 0) {
+		blocks_give(this, this->blocks[this->first_block]);
+		this->first_block = (this->first_block + 1) & (this->block_capacity - 1);
+		this->used_blocks--;
+	}
+	this->head = 0;
+	spill_reset(this);
+	blocks_trim_map(this);
+}
+
+static void blocks_add_right(deque_ds *const this) {
+	if (this->used_blocks == this->block_capacity) blocks_resize_map(this, this->block_capacity << 1);
+	this->blocks[(this->first_block + this->used_blocks) & (this->block_capacity - 1)] = blocks_take(this);
+	this->used_blocks++;
+	spill_enforce(this);
+}
+
+/* called once elements were taken from the left, gives back the leftmost block if that emptied it */
+static void blocks_release_left(deque_ds *const this) {
+	if (this->len == 0) {
+		blocks_drain(this);
+	} else if (this->head == BLOCK_SIZE) {
+		blocks_give(this, this->blocks[this->first_block]);
+		this->first_block = (this->first_block + 1) & (this->block_capacity - 1);
+		this->used_blocks--;
+		this->head = 0;
+		
+		if (this->spill_first != this->spill_end) {
+			this->spill_first--;
+			this->spill_end--;
+			if (this->spill_first == 0) spill_read_left(this);
+		}
+		blocks_trim_map(this);
+	}
+}
+
+static void blocks_pushleft(deque_ds *const this, void *el) {
+	if (this->head == 0) {
+		if (this->used_blocks == this->block_capacity) blocks_resize_map(this, this->block_capacity << 1);
+		this->first_block = (this->first_block - 1) & (this->block_capacity - 1);
+		this->blocks[this->first_block] = blocks_take(this);
+		this->used_blocks++;
+		this->head = BLOCK_SIZE;
+		
+		if (this->spill_first != this->spill_end) {
+			this->spill_first++;
+			this->spill_end++;
+		}
+		spill_enforce(this);
+	}
+	this->head--;
+	this->blocks[this->first_block][this->head] = el;
+	this->len++;
+}
+
+static void blocks_pushright(deque_ds *const this, void *el) {
+	size_t pos = this->head + this->len;
+	if (pos == this->used_blocks << BLOCK_SHIFT) blocks_add_right(this);
+	BLOCK_AT(this, pos)[pos & (BLOCK_SIZE - 1)] = el;
+	this->len++;
+}
+
+static void *blocks_popleft(deque_ds *const this) {
+	void *el;
+	if (this->len == 0) return NULL;
+	el = this->blocks[this->first_block][this->head];
+	this->head++;
+	this->len--;
+	blocks_release_left(this);
+	return el;
+}
+
+static void *blocks_popright(deque_ds *const this) {
+	void *el;
+	size_t pos;
+	if (this->len == 0) return NULL;
+	this->len--;
+	pos = this->head + this->len;
+	el = BLOCK_AT(this, pos)[pos & (BLOCK_SIZE - 1)];
+	
+	if (this->len == 0) {
+		blocks_drain(this);
+	} else if ((pos & (BLOCK_SIZE - 1)) == 0) {
+		this->used_blocks--;
+		blocks_give(this, this->blocks[(this->first_block + this->used_blocks) & (this->block_capacity - 1)]);
+		if (this->spill_first != this->spill_end && this->spill_end == this->used_blocks) spill_read_right(this);
+		blocks_trim_map(this);
+	}
 	return el;
 }
 
+/* every block is filled by a single copy */
+static void blocks_pushright_n(deque_ds *const this, void *const *els, size_t n) {
+	while (n > 0) {
+		size_t count, pos = this->head + this->len;
+		if (pos == this->used_blocks << BLOCK_SHIFT) blocks_add_right(this);
+		
+		count = BLOCK_SIZE - (pos & (BLOCK_SIZE - 1));
+		if (count > n) count = n;
+		memcpy(BLOCK_AT(this, pos) + (pos & (BLOCK_SIZE - 1)), els, count * sizeof *els);
+		els += count;
+		n -= count;
+		this->len += count;
+	}
+}
+
+static size_t blocks_popleft_n(deque_ds *const this, void **out, size_t n) {
+	size_t popped = 0;
+	if (n > this->len) n = this->len;
+	
+	while (popped < n) {
+		size_t count = BLOCK_SIZE - this->head;
+		if (count > n - popped) count = n - popped;
+		memcpy(out + popped, this->blocks[this->first_block] + this->head, count * sizeof *out);
+		popped += count;
+		this->head += count;
+		this->len -= count;
+		blocks_release_left(this);
+	}
+	return popped;
+}
+
+/*** BLOCK ENGINE - END ***/
+
+void deque_pushleft(deque_ds *const this, void *el) {
+	if (this->engine == DEQUE_BLOCKS) {
+		blocks_pushleft(this, el);
+	} else {
+		ring_pushleft(this, el);
+	}
+}
+
+/* analogous to enqueue and stack push */
+void deque_pushright(deque_ds *const this, void *el) {
+	if (this->engine == DEQUE_BLOCKS) {
+		blocks_pushright(this, el);
+	} else {
+		ring_pushright(this, el);
+	}
+}
+
+/* analogous to dequeue */
+void *deque_popleft(deque_ds *const this) {
+	return this->engine == DEQUE_BLOCKS ? blocks_popleft(this) : ring_popleft(this);
+}
+
+/* analogus to stack pop */
+void *deque_popright(deque_ds *const this) {
+	return this->engine == DEQUE_BLOCKS ? blocks_popright(this) : ring_popright(this);
+}
+
+void deque_pushright_n(deque_ds *const this, void *const *els, size_t n) {
+	if (this->engine == DEQUE_BLOCKS) {
+		blocks_pushright_n(this, els, n);
+	} else {
+		ring_pushright_n(this, els, n);
+	}
+}
+
+size_t deque_popleft_n(deque_ds *const this, void **out, size_t n) {
+	return this->engine == DEQUE_BLOCKS ? blocks_popleft_n(this, out, n) : ring_popleft_n(this, out, n);
+}
+
+void **deque_span(deque_ds *const this, size_t index, size_t *length) {
+	size_t slot, contiguous;
+	if (index >= this->len) {
+		*length = 0;
+		return NULL;
+	}
+	
+	/* runs end at the wraparound of the array, or at the end of a block */
+	if (this->engine == DEQUE_BLOCKS) {
+		size_t pos = this->head + index;
+		slot = pos & (BLOCK_SIZE - 1);
+		contiguous = BLOCK_SIZE - slot;
+		*length = contiguous < this->len - index ? contiguous : this->len - index;
+		return blocks_get(this, pos >> BLOCK_SHIFT, 1) + slot;
+	}
+	slot = (this->head + index) & (this->capacity - 1);
+	contiguous = this->capacity - slot;
+	*length = contiguous < this->len - index ? contiguous : this->len - index;
+	return this->deque + slot;
+}
+
+/* slot of the element at the given index, which must be less than the deque's size */
+static void **deque_slot(deque_ds *const this, size_t index, int writing) {
+	if (this->engine == DEQUE_BLOCKS) {
+		size_t pos = this->head + index;
+		return blocks_get(this, pos >> BLOCK_SHIFT, writing) + (pos & (BLOCK_SIZE - 1));
+	}
+	return this->deque + ((this->head + index) & (this->capacity - 1));
+}
+
+void *deque_get(deque_ds *const this, size_t index) {
+	if (index >= this->len) return NULL;
+	return *deque_slot(this, index, 0);
+}
+
+int deque_set(deque_ds *const this, size_t index, void *el) {
+	if (index >= this->len) return 0;
+	*deque_slot(this, index, 1) = el;
+	return 1;
+}
+
 void *deque_peekleft(deque_ds *const this) {
-	return this->deque[this->head];
+	return deque_get(this, 0);
 }
 
 void *deque_peekright(deque_ds *const this) {
-	return this->deque[(this->tail - 1) & (this->capacity - 1)];
+	if (this->len == 0) return NULL;
+	return *deque_slot(this, this->len - 1, 0);
 }
 
 int deque_isempty(deque_ds *const this) {
 	return this->len == 0;
 }
+
+size_t deque_size(deque_ds *const this) {
+	return this->len;
+}
+
+int deque_set_budget(deque_ds *const this, size_t bytes) {
+	if (this->engine != DEQUE_BLOCKS) return 0;
+	
+	if (bytes == 0) {
+		if (this->spill == NULL) return 1;
+		this->budget = 0;
+		this->readahead = this->spill_end - this->spill_first;
+		if (this->readahead > 0) spill_read_left(this);
+		fclose(this->spill);
+		ds_free(&this->allocator, this->window, BLOCK_BYTES);
+		this->spill = NULL;
+		this->window = NULL;
+		return 1;
+	}
+	
+	if (this->spill == NULL) {
+		this->spill = tmpfile();
+		if (this->spill == NULL) return 0;
+		/* a buffer of a whole readahead turns spilling consecutive blocks into large sequential writes */
+		setvbuf(this->spill, NULL, _IOFBF, READAHEAD_BLOCKS * BLOCK_BYTES);
+		this->spill_position = -1;
+		this->window = ds_alloc(&this->allocator, BLOCK_BYTES);
+		DS_ASSERT(this->window != NULL, "failed to allocate memory for the " DS_NAME "'s window");
+	}
+	
+	/* the leftmost and rightmost blocks always stay, and blocks are read back a readahead at a time */
+	this->budget = bytes / BLOCK_BYTES;
+	if (this->budget < 3) this->budget = 3;
+	this->readahead = this->budget - 2 < READAHEAD_BLOCKS ? this->budget - 2 : READAHEAD_BLOCKS;
+	spill_enforce(this);
+	return 1;
+}
+
+size_t deque_spilled(deque_ds *const this) {
+	return (this->spill_end - this->spill_first) << BLOCK_SHIFT;
+}
+
+void deque_reserve(deque_ds *const this, size_t capacity) {
+	this->reserved = capacity;
+	if (this->engine == DEQUE_BLOCKS) {
+		size_t map = this->block_capacity;
+		while (map < BLOCKS_FOR(capacity)) {
+			map <<= 1;
+		}
+		if (map != this->block_capacity) blocks_resize_map(this, map);
+	} else {
+		size_t ring = this->capacity;
+		while (ring < capacity) {
+			ring <<= 1;
+		}
+		if (ring != this->capacity) deque_resize(this, ring);
+	}
+}
+
+void deque_shrink_to_fit(deque_ds *const this) {
+	this->reserved = 0;
+	if (this->engine == DEQUE_BLOCKS) {
+		size_t map = INITIAL_BLOCK_CAPACITY;
+		while (map < this->used_blocks) {
+			map <<= 1;
+		}
+		if (map != this->block_capacity) blocks_resize_map(this, map);
+		ds_free(&this->allocator, this->spare, BLOCK_BYTES);
+		this->spare = NULL;
+	} else {
+		size_t ring = INITIAL_CAPACITY;
+		while (ring < this->len) {
+			ring <<= 1;
+		}
+		if (ring != this->capacity) deque_resize(this, ring);
+	}
+}
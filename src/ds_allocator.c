@@ -0,0 +1,228 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DS_NAME "allocator"
+#include "err/ds_assert.h"
+#include "ds_allocator.h"
+
+#define DEFAULT_BLOCK_SIZE (64 * 1024)
+#define DEFAULT_OBJECTS_PER_SLAB 64
+
+/* every allocation is aligned for the most demanding of the usual types */
+typedef union max_align {
+	long l;
+	double d;
+	void *p;
+	size_t s;
+} max_align;
+
+#define ALIGN(size) (((size) + sizeof(max_align) - 1) / sizeof(max_align) * sizeof(max_align))
+
+typedef struct arena_block {
+	struct arena_block *next;
+	max_align data[1];		/* actually as large as the block was allocated */
+} arena_block;
+
+struct ds_arena {
+	size_t block_size;
+	arena_block *blocks;	/* the block being carved out of comes first */
+	arena_block *first;		/* kept across resets */
+	char *cursor;
+	char *end;
+};
+
+typedef struct pool_slab {
+	struct pool_slab *next;
+	max_align data[1];		/* actually objects_per_slab objects */
+} pool_slab;
+
+struct ds_pool {
+	size_t object_size;
+	size_t objects_per_slab;
+	ds_allocator backing;
+	pool_slab *slabs;
+	void *free_list;		/* each free object starts with a pointer to the next one */
+};
+
+static void *default_alloc(void *context, size_t size) {
+	(void)context;
+	return malloc(size);
+}
+
+static void default_free(void *context, void *ptr, size_t size) {
+	(void)context;
+	(void)size;
+	free(ptr);
+}
+
+const ds_allocator ds_default_allocator = {default_alloc, default_free, NULL};
+
+void *ds_alloc(const ds_allocator *const allocator, size_t size) {
+	return allocator->alloc(allocator->context, size);
+}
+
+void ds_free(const ds_allocator *const allocator, void *ptr, size_t size) {
+	if (ptr != NULL) allocator->free(allocator->context, ptr, size);
+}
+
+void *ds_realloc(const ds_allocator *const allocator, void *ptr, size_t old_size, size_t new_size) {
+	void *resized;
+	if (allocator->alloc == default_alloc) return realloc(ptr, new_size);
+	
+	resized = ds_alloc(allocator, new_size);
+	if (resized == NULL) return NULL;
+	memcpy(resized, ptr, old_size < new_size ? old_size : new_size);
+	ds_free(allocator, ptr, old_size);
+	return resized;
+}
+
+static arena_block *arena_alloc_block(size_t size) {
+	return malloc(offsetof(arena_block, data) + size);
+}
+
+ds_arena *alloc_arena(size_t block_size) {
+	ds_arena *this = malloc(sizeof *this);
+	DS_ASSERT(this != NULL, "failed to allocate memory for new arena");
+	
+	this->block_size = ALIGN(block_size != 0 ? block_size : DEFAULT_BLOCK_SIZE);
+	this->blocks = arena_alloc_block(this->block_size);
+	DS_ASSERT(this->blocks != NULL, "failed to allocate memory for the arena's first block");
+	this->blocks->next = NULL;
+	this->first = this->blocks;
+	this->cursor = (char*)this->blocks->data;
+	this->end = this->cursor + this->block_size;
+	return this;
+}
+
+void dealloc_arena(ds_arena *const this) {
+	arena_reset(this);
+	free(this->blocks);
+	free(this);
+}
+
+void arena_reset(ds_arena *const this) {
+	arena_block *block = this->blocks, *next;
+	while (block != NULL) {
+		next = block->next;
+		if (block != this->first) free(block);
+		block = next;
+	}
+	this->blocks = this->first;
+	this->blocks->next = NULL;
+	this->cursor = (char*)this->blocks->data;
+	this->end = this->cursor + this->block_size;
+}
+
+static void *arena_alloc(void *context, size_t size) {
+	ds_arena *this = context;
+	arena_block *block;
+	void *ptr;
+	
+	size = ALIGN(size);
+	if (size > (size_t)(this->end - this->cursor)) {
+		if (size > this->block_size / 4) {
+			/* large requests get a block of their own behind the current one, which keeps its leftover space */
+			if ((block = arena_alloc_block(size)) == NULL) return NULL;
+			block->next = this->blocks->next;
+			this->blocks->next = block;
+			return block->data;
+		}
+		if ((block = arena_alloc_block(this->block_size)) == NULL) return NULL;
+		block->next = this->blocks;
+		this->blocks = block;
+		this->cursor = (char*)block->data;
+		this->end = this->cursor + this->block_size;
+	}
+	
+	ptr = this->cursor;
+	this->cursor += size;
+	return ptr;
+}
+
+static void arena_free(void *context, void *ptr, size_t size) {
+	ds_arena *this = context;
+	
+	/* only the latest allocation can be handed back, everything else waits for the arena to go */
+	if ((char*)ptr >= (char*)this->blocks->data && (char*)ptr + ALIGN(size) == this->cursor) {
+		this->cursor = ptr;
+	}
+}
+
+ds_allocator arena_allocator(ds_arena *const this) {
+	ds_allocator allocator;
+	allocator.alloc = arena_alloc;
+	allocator.free = arena_free;
+	allocator.context = this;
+	return allocator;
+}
+
+ds_pool *alloc_pool(size_t object_size, size_t objects_per_slab, const ds_allocator *backing) {
+	ds_pool *this = malloc(sizeof *this);
+	DS_ASSERT(this != NULL, "failed to allocate memory for new pool");
+	
+	this->object_size = ALIGN(object_size != 0 ? object_size : 1);
+	this->objects_per_slab = objects_per_slab != 0 ? objects_per_slab : DEFAULT_OBJECTS_PER_SLAB;
+	this->backing = backing != NULL ? *backing : ds_default_allocator;
+	this->slabs = NULL;
+	this->free_list = NULL;
+	return this;
+}
+
+void dealloc_pool(ds_pool *const this) {
+	pool_slab *next;
+	while (this->slabs != NULL) {
+		next = this->slabs->next;
+		ds_free(&this->backing, this->slabs, offsetof(pool_slab, data) + this->object_size * this->objects_per_slab);
+		this->slabs = next;
+	}
+	free(this);
+}
+
+static void *pool_alloc(void *context, size_t size) {
+	ds_pool *this = context;
+	void *ptr;
+	
+	if (size > this->object_size) return this->backing.alloc(this->backing.context, size);
+	
+	if (this->free_list == NULL) {
+		size_t i;
+		char *object;
+		pool_slab *slab = this->backing.alloc(this->backing.context, offsetof(pool_slab, data) + this->object_size * this->objects_per_slab);
+		if (slab == NULL) return NULL;
+		
+		slab->next = this->slabs;
+		this->slabs = slab;
+		
+		/* thread the new objects onto the free list, first one first */
+		object = (char*)slab->data + this->object_size * this->objects_per_slab;
+		for (i = 0; i < this->objects_per_slab; i++) {
+			object -= this->object_size;
+			*(void**)object = this->free_list;
+			this->free_list = object;
+		}
+	}
+	
+	ptr = this->free_list;
+	this->free_list = *(void**)ptr;
+	return ptr;
+}
+
+static void pool_free(void *context, void *ptr, size_t size) {
+	ds_pool *this = context;
+	
+	if (size > this->object_size) {
+		this->backing.free(this->backing.context, ptr, size);
+		return;
+	}
+	*(void**)ptr = this->free_list;
+	this->free_list = ptr;
+}
+
+ds_allocator pool_allocator(ds_pool *const this) {
+	ds_allocator allocator;
+	allocator.alloc = pool_alloc;
+	allocator.free = pool_free;
+	allocator.context = this;
+	return allocator;
+}
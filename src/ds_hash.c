@@ -0,0 +1,162 @@
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "ds_hash.h"
+
+/* xxHash's primes of the widest width an unsigned long can hold */
+#if ULONG_MAX > 0xffffffffUL
+#define PRIME_1 ((size_t)0x9E3779B185EBCA87UL)
+#define PRIME_2 ((size_t)0xC2B2AE3D27D4EB4FUL)
+#define PRIME_3 ((size_t)0x165667B19E3779F9UL)
+#define PRIME_4 ((size_t)0x85EBCA77C2B2AE63UL)
+#define PRIME_5 ((size_t)0x27D4EB2F165667C5UL)
+#define ROUND_ROTATION 31
+#define AVALANCHE(h) ((h) ^= (h) >> 33, (h) *= PRIME_2, (h) ^= (h) >> 29, (h) *= PRIME_3, (h) ^= (h) >> 32)
+#else
+#define PRIME_1 ((size_t)0x9E3779B1UL)
+#define PRIME_2 ((size_t)0x85EBCA77UL)
+#define PRIME_3 ((size_t)0xC2B2AE3DUL)
+#define PRIME_4 ((size_t)0x27D4EB2FUL)
+#define PRIME_5 ((size_t)0x165667B1UL)
+#define ROUND_ROTATION 13
+#define AVALANCHE(h) ((h) ^= (h) >> 15, (h) *= PRIME_2, (h) ^= (h) >> 13, (h) *= PRIME_3, (h) ^= (h) >> 16)
+#endif
+
+#define WORD (sizeof(size_t))
+#define ROTL(x, r) (((x) << (r)) | ((x) >> (WORD * CHAR_BIT - (r))))
+
+static size_t process_seed;
+static pthread_once_t seed_once = PTHREAD_ONCE_INIT;
+
+static void ds_hash_draw_seed(void) {
+	FILE *source = fopen("/dev/urandom", "rb");
+	int stack;
+	
+	/* without a random source, settle for whatever differs between processes */
+	if (source == NULL || fread(&process_seed, sizeof process_seed, 1, source) != 1) {
+		process_seed = (size_t)time(NULL) ^ ((size_t)clock() << 16) ^ ((size_t)getpid() << 8) ^ (size_t)&stack;
+		AVALANCHE(process_seed);
+	}
+	if (source != NULL) fclose(source);
+}
+
+size_t ds_hash_seed(void) {
+	pthread_once(&seed_once, ds_hash_draw_seed);
+	return process_seed;
+}
+
+void ds_hash_set_seed(size_t value) {
+	/* draw first, so that a later first call to ds_hash_seed() doesn't overwrite the seed again */
+	pthread_once(&seed_once, ds_hash_draw_seed);
+	process_seed = value;
+}
+
+static size_t ds_hash_read(const unsigned char *p) {
+	size_t word;
+	memcpy(&word, p, sizeof word);
+	return word;
+}
+
+static size_t ds_hash_round(size_t acc, size_t input) {
+	acc += input * PRIME_2;
+	acc = ROTL(acc, ROUND_ROTATION);
+	return acc * PRIME_1;
+}
+
+static size_t ds_hash_merge(size_t h, size_t lane) {
+	h ^= ds_hash_round(0, lane);
+	return h * PRIME_1 + PRIME_4;
+}
+
+/* folds the words and bytes that don't fill a whole stripe of four lanes */
+static size_t ds_hash_tail(size_t h, const unsigned char *p, const unsigned char *end) {
+	for (; (size_t)(end - p) >= WORD; p += WORD) {
+		h ^= ds_hash_round(0, ds_hash_read(p));
+		h = ROTL(h, 27) * PRIME_1 + PRIME_4;
+	}
+	for (; p < end; p++) {
+		h ^= *p * PRIME_5;
+		h = ROTL(h, 11) * PRIME_1;
+	}
+	AVALANCHE(h);
+	return h;
+}
+
+size_t ds_hash_bytes(const void *data, size_t length, size_t seed) {
+	const unsigned char *p = data, *end = p + length;
+	size_t h;
+	
+	if (length >= 4 * WORD) {
+		size_t v1 = seed + PRIME_1 + PRIME_2, v2 = seed + PRIME_2, v3 = seed, v4 = seed - PRIME_1;
+		
+		do {
+			v1 = ds_hash_round(v1, ds_hash_read(p));
+			v2 = ds_hash_round(v2, ds_hash_read(p + WORD));
+			v3 = ds_hash_round(v3, ds_hash_read(p + 2 * WORD));
+			v4 = ds_hash_round(v4, ds_hash_read(p + 3 * WORD));
+			p += 4 * WORD;
+		} while ((size_t)(end - p) >= 4 * WORD);
+		
+		h = ROTL(v1, 1) + ROTL(v2, 7) + ROTL(v3, 12) + ROTL(v4, 18);
+		h = ds_hash_merge(h, v1);
+		h = ds_hash_merge(h, v2);
+		h = ds_hash_merge(h, v3);
+		h = ds_hash_merge(h, v4);
+	} else {
+		h = seed + PRIME_5;
+	}
+	return ds_hash_tail(h + length, p, end);
+}
+
+size_t ds_hash_string(const char *string, size_t seed) {
+	return ds_hash_bytes(string, strlen(string), seed);
+}
+
+size_t ds_hash_word(size_t value, size_t seed) {
+	/* the tail of hashing the value's bytes, without going through memory */
+	size_t h = seed + PRIME_5 + WORD;
+	h ^= ds_hash_round(0, value);
+	h = ROTL(h, 27) * PRIME_1 + PRIME_4;
+	AVALANCHE(h);
+	return h;
+}
+
+int ds_string_hash(const void *key) {
+	return (int)ds_string_hash64(key);
+}
+
+size_t ds_string_hash64(const void *key) {
+	return ds_hash_string(key, ds_hash_seed());
+}
+
+int ds_string_equals(const void *key_1, const void *key_2) {
+	return strcmp(key_1, key_2) == 0;
+}
+
+int ds_int_hash(const void *key) {
+	return (int)ds_int_hash64(key);
+}
+
+size_t ds_int_hash64(const void *key) {
+	return ds_hash_word((unsigned)*(const int*)key, ds_hash_seed());
+}
+
+int ds_int_equals(const void *key_1, const void *key_2) {
+	return *(const int*)key_1 == *(const int*)key_2;
+}
+
+int ds_long_hash(const void *key) {
+	return (int)ds_long_hash64(key);
+}
+
+size_t ds_long_hash64(const void *key) {
+	return ds_hash_word((unsigned long)*(const long*)key, ds_hash_seed());
+}
+
+int ds_long_equals(const void *key_1, const void *key_2) {
+	return *(const long*)key_1 == *(const long*)key_2;
+}
@@ -1,11 +1,13 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include "hashmap.h"
 #include "pqueue.h"
 #include "deque.h"
 
 #define DS_NAME "graph"
 #include "err/ds_assert.h"
+#include "ds_allocator.h"
 #include "graph.h"
 
 /* graph abstract data type */
@@ -14,6 +16,7 @@ struct graph_ds {
 	int (*label_equals)(const void*, const void*);
 	hashmap_ds *adj_list;
 	int num_edges;
+	ds_allocator allocator;
 };
 
 /* basic unit of the graph */
@@ -23,6 +26,7 @@ typedef struct graph_vertex {
 	struct graph_vertex *predecessor;
 	graph_ds *this;
 	double cost;
+	size_t position;	/* handle of the vertex in dijkstra's intrusive pqueue */
 	int visited;
 } vertex;
 
@@ -36,6 +40,7 @@ static void init_vertex(vertex *v, void *label, graph_ds *const this) {
 	v->predecessor = NULL;
 	v->this = this;
 	v->cost = 0.0;
+	v->position = 0;
 	v->visited = 0;
 }
 
@@ -80,12 +85,20 @@ static int vertex_equality(const void *V_1, const void *V_2) {
 }
 
 graph_ds *alloc_graph(int label_hash(const void*), int label_equals(const void*, const void*)) {
-	graph_ds *this = malloc(sizeof *this);
+	return alloc_graph_with(label_hash, label_equals, NULL);
+}
+
+graph_ds *alloc_graph_with(int label_hash(const void*), int label_equals(const void*, const void*), const ds_allocator *allocator) {
+	graph_ds *this;
+	if (allocator == NULL) allocator = &ds_default_allocator;
+	
+	this = ds_alloc(allocator, sizeof *this);
 	DS_ASSERT(this != NULL, "failed to allocate memory for new " DS_NAME);
 	
+	this->allocator = *allocator;
 	this->label_hash = label_hash;
 	this->label_equals = label_equals;
-	this->adj_list = alloc_hashmap(vertex_hash, vertex_equality);
+	this->adj_list = alloc_hashmap_with(vertex_hash, vertex_equality, HASHMAP_ROBINHOOD, allocator);
 	this->num_edges = 0;
 	return this;
 }
@@ -96,13 +109,13 @@ void dealloc_graph(graph_ds *const this) {
 	hashmap_entry **outer_entries = hashmap_getentries(this->adj_list);
 	for (i = 0; outer_entries[i] != NULL; i++) {
 		/* free the vertex */
-		free(outer_entries[i]->key);
+		ds_free(&this->allocator, outer_entries[i]->key, sizeof(vertex));
 		
 		/* each vertex maps to another hashmap, process those */
 		inner_entries = hashmap_getentries(outer_entries[i]->value);
 		for (j = 0; inner_entries[j] != NULL; j++) {
 			/* free the weight */
-			free(inner_entries[j]->value);
+			ds_free(&this->allocator, inner_entries[j]->value, sizeof(double));
 		}
 		
 		/* we're done processing the inner hashmap */
@@ -114,20 +127,20 @@ void dealloc_graph(graph_ds *const this) {
 	
 	free(outer_entries);
 	dealloc_hashmap(this->adj_list);
-	free(this);
+	ds_free(&this->allocator, this, sizeof *this);
 }
 
 int graph_add_vertex(graph_ds *const this, void *label) {
-	vertex *new_vertex = malloc(sizeof *new_vertex);
+	vertex *new_vertex = ds_alloc(&this->allocator, sizeof *new_vertex);
 	DS_ASSERT(new_vertex != NULL, "failed to allocate memory for new vertex");
 	init_vertex(new_vertex, label, this);
 	
 	if (hashmap_get(this->adj_list, new_vertex) == NULL) {
-		hashmap_put(this->adj_list, new_vertex, alloc_hashmap(vertex_hash, vertex_equality));
+		hashmap_put(this->adj_list, new_vertex, alloc_hashmap_with(vertex_hash, vertex_equality, HASHMAP_ROBINHOOD, &this->allocator));
 		return 1;
 	}
 	
-	free(new_vertex);
+	ds_free(&this->allocator, new_vertex, sizeof *new_vertex);
 	return 0;
 }
 
@@ -139,12 +152,12 @@ int graph_add_edge(graph_ds *const this, void *a, void *b, double weight) {
 		/* edge already exists */
 		if (hashmap_get(hashmap_get(this->adj_list, a_v), b_v) != NULL) return 0;
 		
-		vertex_weight = malloc(sizeof *vertex_weight);
+		vertex_weight = ds_alloc(&this->allocator, sizeof *vertex_weight);
 		DS_ASSERT(vertex_weight != NULL, "failed to allocate memory for new edge weight connecting a to b");
 		*vertex_weight = weight;
 		hashmap_put(hashmap_get(this->adj_list, a_v), b_v, vertex_weight);
 		
-		vertex_weight = malloc(sizeof *vertex_weight);
+		vertex_weight = ds_alloc(&this->allocator, sizeof *vertex_weight);
 		DS_ASSERT(vertex_weight != NULL, "failed to allocate memory for new edge weight connecting b to a");
 		*vertex_weight = weight;
 		hashmap_put(hashmap_get(this->adj_list, b_v), a_v, vertex_weight);
@@ -162,8 +175,8 @@ int graph_remove_edge(graph_ds *const this, void *a, void *b) {
 	vertex *b_v = corresponding_vertex(this, b);
 	if (a_v != NULL && b_v != NULL && hashmap_get(hashmap_get(this->adj_list, a_v), b_v) != NULL) {
 		/* disconnect the vertex in both inner hashmaps whilist freeing dynamically allocated weights */
-		free(hashmap_remove(hashmap_get(this->adj_list, a_v), b_v));
-		free(hashmap_remove(hashmap_get(this->adj_list, b_v), a_v));
+		ds_free(&this->allocator, hashmap_remove(hashmap_get(this->adj_list, a_v), b_v), sizeof(double));
+		ds_free(&this->allocator, hashmap_remove(hashmap_get(this->adj_list, b_v), a_v), sizeof(double));
 		
 		a_v->degree -= 1;
 		b_v->degree -= 1;
@@ -176,15 +189,24 @@ int graph_remove_edge(graph_ds *const this, void *a, void *b) {
 int graph_remove_vertex(graph_ds *const this, void *label) {
 	vertex *removal = corresponding_vertex(this, label);
 	if (removal != NULL) {
-		size_t i;
-		hashmap_entry **entries;
-		entries = hashmap_getentries(hashmap_get(this->adj_list, removal));
-		for (i = 0; entries[i] != NULL; i++) {
-			graph_remove_edge(this, label, ((vertex*)entries[i]->key)->label);
+		hashmap_ds_iterator edge_itr = hashmap_getiterator(hashmap_get(this->adj_list, removal));
+		
+		/* removing an edge shifts the entries of the inner hashmap, so the neighbors are collected up front */
+		if (removal->degree != 0) {
+			size_t i, neighbors = 0;
+			void **labels = ds_alloc(&this->allocator, removal->degree * sizeof *labels);
+			DS_ASSERT(labels != NULL, "failed to allocate memory for the neighbors of a vertex");
+			
+			while (hashmap_iterator_hasnext(&edge_itr)) {
+				labels[neighbors++] = ((vertex*)hashmap_iterator_next(&edge_itr)->key)->label;
+			}
+			for (i = 0; i < neighbors; i++) {
+				graph_remove_edge(this, label, labels[i]);
+			}
+			ds_free(&this->allocator, labels, removal->degree * sizeof *labels);
 		}
-		free(entries);
 		dealloc_hashmap(hashmap_remove(this->adj_list, removal));
-		free(removal);
+		ds_free(&this->allocator, removal, sizeof *removal);
 		return 1;
 	}
 	return 0;
@@ -203,11 +225,11 @@ static deque_ds *graph_breadth_first_search_internal(graph_ds *const this, void
 	deque_ds *retval, *bfs;
 	vertex *process, *origin_v = corresponding_vertex(this, origin);
 	
-	retval = alloc_deque();
+	retval = alloc_deque_with(DEQUE_RING, &this->allocator);
 	if (origin_v == NULL) return retval;
 	
 	graph_reset_vertices(this, ZERO);
-	bfs = alloc_deque();
+	bfs = alloc_deque_with(DEQUE_RING, &this->allocator);
 	deque_enqueue(retval, return_labels ? origin_v->label : origin_v);
 	deque_enqueue(bfs, origin_v);
 	origin_v->visited = 1;
@@ -251,7 +273,7 @@ static void graph_depth_first_search_internal(graph_ds *const this, deque_ds *tr
 }
 
 deque_ds *graph_depth_first_search(graph_ds *const this, void *origin) {
-	deque_ds *retval = alloc_deque();
+	deque_ds *retval = alloc_deque_with(DEQUE_RING, &this->allocator);
 	vertex *origin_v = corresponding_vertex(this, origin);
 	graph_reset_vertices(this, ZERO);
 	if (origin_v != NULL) {
@@ -278,7 +300,7 @@ double graph_cheapest_path(graph_ds *const this, void *origin, void *end, deque_
 	graph_reset_vertices(this, INF);
 	origin_v->cost = 0.0;
 	
-	pq = alloc_pqueue(cost_comparator);
+	pq = alloc_pqueue_intrusive_with(cost_comparator, offsetof(vertex, position), &this->allocator);
 	pqueue_enqueue(pq, origin_v);
 	/* dirty way of checking if the queue is empty */
 	while (pqueue_peek(pq) != NULL) {
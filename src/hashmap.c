@@ -1,199 +1,1523 @@
+#define _POSIX_C_SOURCE 200112L
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
 
 #define DS_NAME "hashmap"
 #include "err/ds_assert.h"
+#include "ds_allocator.h"
 #include "hashmap.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #define INITIAL_CAPACITY 16
 
-static int reference_hash(const void*);
+/* keys hashed and prefetched ahead of being resolved by the batched operations */
+#define BATCH_WIDTH 16
+
+/* copy-on-write snapshots share the table with the hashmap in chunks of this many slots */
+#define CHUNK_SHIFT 8
+#define CHUNK_SLOTS ((size_t)1 << CHUNK_SHIFT)
+#define CHUNK_COUNT(capacity) (((capacity) + CHUNK_SLOTS - 1) >> CHUNK_SHIFT)
+
+/* parallel builds give every thread a range of at least this many slots, and rehashes only go parallel past this size */
+#define BUILD_MIN_RANGE 4096
+#define BUILD_MIN_REHASH (1 << 16)
+
+#ifdef __GNUC__
+#define PREFETCH(addr) __builtin_prefetch(addr)
+#else
+#define PREFETCH(addr) ((void)(addr))
+#endif
+
+/* swiss metadata: occupied slots carry 7 bits of their hash, probed a whole group at a time */
+#define GROUP_WIDTH 16
+#define CTRL_EMPTY 0x00
+#define CTRL_DELETED 0x01
+#define CTRL_FULL 0x80
+#define CTRL_FINGERPRINT(hash) ((unsigned char)(CTRL_FULL | ((((hash) * 2654435761u) >> 25) & 0x7F)))
+
+/* snapshot files: a header, the metadata, the table with offsets in place of pointers, then every payload */
+#define SNAPSHOT_MAGIC "dshmap01"
+#define SNAPSHOT_ALIGNMENT 16
+#define SNAPSHOT_ALIGN(offset) (((offset) + SNAPSHOT_ALIGNMENT - 1) & ~(size_t)(SNAPSHOT_ALIGNMENT - 1))
+
+/* cached hashes are compared first so that is_equals only runs on likely matches */
+#define KEY_MATCHES(this, entry, key_, hash_) ((entry).hash == (hash_) && hashmap_equals(this, (entry).key, key_))
+
+/* instrumentation is only paid for by hashmaps that enabled it */
+#define STATS_ADD(this, counter, amount) do { if ((this)->stats != NULL) (this)->stats->counter += (amount); } while (0)
+
+/* every write to a slot goes through here first, so that snapshots still sharing its chunk get their own copy */
+#define COW_TOUCH(this, i) do { if ((this)->cow != NULL) hashmap_cow_touch(this, (i) >> CHUNK_SHIFT); } while (0)
+
+#define SLOT_OCCUPIED(this, i) ((this)->engine == HASHMAP_SWISS ? ((this)->meta[i] & CTRL_FULL) != 0 : (this)->meta[i] != PSL_VACANT)
+
+static size_t reference_hash(const void*);
 static int reference_equality(const void*, const void*);
+static void hashmap_cow_touch(hashmap_ds*, size_t);
 
-static int absval(int num) {
-	return num < 0 ? -num : num;
-}
+/* running counters of an instrumented hashmap, shared with the table it's migrating */
+typedef struct hashmap_counters {
+	size_t hits;
+	size_t hit_probes;
+	size_t misses;
+	size_t miss_probes;
+	size_t equality_calls;
+	size_t hash_calls;
+	size_t rehashes;
+	double rehash_seconds;
+	size_t probes;			/* probes of the lookup in progress */
+} hashmap_counters;
 
 struct hashmap_ds {
 	int (*hash)(const void*);
+	size_t (*hash64)(const void*);
 	int (*is_equals)(const void*, const void*);
+	hashmap_engine engine;
 	size_t size;
+	size_t tombstones;
 	size_t capacity;
 	size_t load_factor;
-	hashmap_entry **table;
+	hashmap_entry *table;	/* key/value pairs stored inline */
+	unsigned char *meta;	/* dense per-slot metadata: probe sequence lengths or control bytes, depending on the engine */
+	size_t rehash_step;		/* slots migrated per operation while rehashing incrementally, 0 rehashes all at once */
+	size_t rehash_threads;	/* threads that large rehashes are split across */
+	size_t rehash_cursor;	/* last slot of the old table that was migrated */
+	hashmap_ds *rehashing;	/* old table still being migrated, if any */
+	hashmap_counters *stats;	/* NULL unless instrumentation is enabled */
+	void *mapping;			/* snapshot file the table lives in, if the hashmap was loaded from one */
+	size_t mapping_length;
+	struct hashmap_cow *cow;	/* NULL until the first copy-on-write snapshot is taken */
+	ds_allocator allocator;
 };
 
-hashmap_ds *alloc_hashmap(int hash(const void*), int is_equals(const void*, const void*)) {
-	size_t i;
-	
-	hashmap_ds *this = malloc(sizeof *this);
-	DS_ASSERT(this != NULL, "failed to allocate memory for new " DS_NAME);
-	
-	this->hash = hash;
-	this->is_equals = is_equals;
-	
+/* copy of one chunk of the table, shared by every snapshot that was taken before the chunk was written to */
+typedef struct hashmap_chunk {
+	size_t refs;
+	hashmap_entry *table;
+	unsigned char *meta;
+} hashmap_chunk;
+
+struct hashmap_snapshot_ds {
+	hashmap_ds *map;			/* NULL once every chunk has been copied for it, guarded by the cow's lock */
+	struct hashmap_cow *cow;	/* the hashmap's, kept here since the hashmap's fields are the writer's to touch */
+	hashmap_snapshot_ds *next;
+	int (*hash)(const void*);
+	size_t (*hash64)(const void*);
+	int (*is_equals)(const void*, const void*);
+	hashmap_engine engine;
+	size_t size;
+	size_t capacity;
+	size_t chunk_slots;
+	hashmap_chunk **chunks;		/* NULL for chunks still shared with the hashmap's table */
+};
+
+/*
+ * Bookkeeping of the snapshots sharing a hashmap's table. A chunk is shared with every snapshot taken since
+ * the chunk was last copied, i.e. whenever its stamp is behind the generation, which each snapshot advances.
+ * The writer only reads the stamps, so it takes the lock alone when a chunk must be copied, and readers take
+ * it to copy a chunk the writer didn't get to yet. Either copies for every snapshot that shares the chunk.
+ * Snapshots only stay in the list while they share the current table, a rehash copies them off of it.
+ */
+typedef struct hashmap_cow {
+	pthread_mutex_t lock;
+	hashmap_snapshot_ds *snapshots;
+	size_t generation;
+	size_t *stamps;				/* per chunk of the current table, NULL while no snapshot shares any of it */
+	size_t refs;				/* the hashmap and every unreleased snapshot, whichever is last frees the cow */
+} hashmap_cow;
+
+typedef struct hashmap_snapshot_header {
+	char magic[8];
+	size_t word_size;		/* snapshots only load where size_t and pointers look the same */
+	size_t byte_order;
+	size_t engine;
+	size_t wide_hash;		/* whether the hashes were computed by a full-width hash function */
+	size_t size;
+	size_t tombstones;
+	size_t capacity;
+} hashmap_snapshot_header;
+
+static void hashmap_alloc_table(hashmap_ds *const this, size_t capacity) {
 	this->size = 0;
-	this->capacity = INITIAL_CAPACITY;
-	this->load_factor = (INITIAL_CAPACITY * 3) >> 2;
-	this->table = malloc(INITIAL_CAPACITY * sizeof *this->table);
+	this->tombstones = 0;
+	this->capacity = capacity;
+	this->load_factor = (capacity * 3) >> 2;
+	this->table = ds_alloc(&this->allocator, capacity * sizeof *this->table);
 	DS_ASSERT(this->table != NULL, "failed to allocate memory for the " DS_NAME "'s table");
 	
-	for (i = 0; i < INITIAL_CAPACITY; i++) {
-		this->table[i] = NULL;
-	}
+	this->meta = ds_alloc(&this->allocator, capacity * sizeof *this->meta);
+	DS_ASSERT(this->meta != NULL, "failed to allocate memory for the " DS_NAME "'s metadata");
+	memset(this->meta, 0, capacity * sizeof *this->meta);
+}
+
+hashmap_ds *alloc_hashmap64_with(size_t hash(const void*), int is_equals(const void*, const void*), hashmap_engine engine, const ds_allocator *allocator) {
+	hashmap_ds *this;
+	if (allocator == NULL) allocator = &ds_default_allocator;
+	
+	this = ds_alloc(allocator, sizeof *this);
+	DS_ASSERT(this != NULL, "failed to allocate memory for new " DS_NAME);
 	
+	this->allocator = *allocator;
+	this->hash = NULL;
+	this->hash64 = hash;
+	this->is_equals = is_equals;
+	this->engine = engine;
+	this->rehash_step = 0;
+	this->rehash_threads = 1;
+	this->rehashing = NULL;
+	this->stats = NULL;
+	this->mapping = NULL;
+	this->cow = NULL;
+	hashmap_alloc_table(this, INITIAL_CAPACITY);
 	return this;
 }
 
+hashmap_ds *alloc_hashmap64(size_t hash(const void*), int is_equals(const void*, const void*), hashmap_engine engine) {
+	return alloc_hashmap64_with(hash, is_equals, engine, NULL);
+}
+
+hashmap_ds *alloc_hashmap_with(int hash(const void*), int is_equals(const void*, const void*), hashmap_engine engine, const ds_allocator *allocator) {
+	hashmap_ds *this = alloc_hashmap64_with(NULL, is_equals, engine, allocator);
+	this->hash = hash;
+	return this;
+}
+
+hashmap_ds *alloc_hashmap_engine(int hash(const void*), int is_equals(const void*, const void*), hashmap_engine engine) {
+	return alloc_hashmap_with(hash, is_equals, engine, NULL);
+}
+
+hashmap_ds *alloc_hashmap(int hash(const void*), int is_equals(const void*, const void*)) {
+	return alloc_hashmap_engine(hash, is_equals, HASHMAP_ROBINHOOD);
+}
+
 hashmap_ds *alloc_identityhashmap() {
-	return alloc_hashmap(reference_hash, reference_equality);
+	return alloc_identityhashmap_with(NULL);
+}
+
+hashmap_ds *alloc_identityhashmap_with(const ds_allocator *allocator) {
+	return alloc_hashmap64_with(reference_hash, reference_equality, HASHMAP_ROBINHOOD, allocator);
+}
+
+static void hashmap_unshare(hashmap_ds *const this);
+static void hashmap_cow_release(hashmap_cow *const cow);
+
+static void hashmap_free_table(hashmap_ds *const this) {
+	hashmap_unshare(this);
+	if (this->mapping != NULL) {
+		munmap(this->mapping, this->mapping_length);
+		return;
+	}
+	ds_free(&this->allocator, this->table, this->capacity * sizeof *this->table);
+	ds_free(&this->allocator, this->meta, this->capacity * sizeof *this->meta);
 }
 
 void dealloc_hashmap(hashmap_ds *const this) {
-	size_t i, capacity;
-	for (i = 0, capacity = this->capacity; i < capacity; i++) {
-		if (this->table[i] != NULL) free(this->table[i]);
+	if (this->rehashing != NULL) {
+		hashmap_free_table(this->rehashing);
+		ds_free(&this->allocator, this->rehashing, sizeof *this->rehashing);
 	}
-	free(this->table);
-	free(this);
+	hashmap_free_table(this);
+	
+	/* freeing the table detached every snapshot, which may still be releasing itself on another thread */
+	if (this->cow != NULL) hashmap_cow_release(this->cow);
+	ds_free(&this->allocator, this->stats, sizeof *this->stats);
+	ds_free(&this->allocator, this, sizeof *this);
 }
 
-static int reference_hash(const void *E) {
-	/* Thomas Wang's 64 bit to 32 bit hash function */
+static size_t reference_hash(const void *E) {
+	/* Thomas Wang's 64 bit integer hash function */
 	size_t value = (size_t)E;
-	value = (~value) + (value << 18);
-	value = value ^ (value >> 31);
+	value = (~value) + (value << 21);
+	value = value ^ (value >> 24);
+	value = value * 265;
+	value = value ^ (value >> 14);
 	value = value * 21;
-	value = value ^ (value >> 11);
-	value = value + (value << 6);
-	value = value ^ (value >> 22);
-	return (int)value;
+	value = value ^ (value >> 28);
+	value = value + (value << 31);
+	return value;
 }
 
 static int reference_equality(const void *E_1, const void *E_2) {
 	return E_1 == E_2;
 }
 
+static int hashmap_equals(hashmap_ds *const this, const void *key_1, const void *key_2) {
+	STATS_ADD(this, equality_calls, 1);
+	return this->is_equals(key_1, key_2);
+}
+
+static size_t hashmap_hashof(hashmap_ds *const this, const void *key) {
+	STATS_ADD(this, hash_calls, 1);
+	
+	/* int hashes are taken as unsigned so that every bit is kept, INT_MIN included */
+	return this->hash64 != NULL ? this->hash64(key) : (size_t)(unsigned)this->hash(key);
+}
+
+/* elapsed time rather than clock(), which would also count whatever other threads do meanwhile */
+static double hashmap_now(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/*** ROBIN-HOOD ENGINE - BEGIN ***/
+
+/* robin-hood metadata: the probe sequence length of every slot, see impl/robinhood.h */
+#define RH_TABLE hashmap_ds
+#define RH_SLOT hashmap_entry
+#define RH_KEY(slot) ((slot).key)
+#define RH_SLOT_HASH(this, i) ((this)->table[i].hash)
+#define RH_MATCHES(this, i, key, hash) KEY_MATCHES(this, (this)->table[i], key, hash)
+#define RH_TOUCH(this, i) COW_TOUCH(this, i)
+#define RH_PROBES(this, n) STATS_ADD(this, probes, n)
+#include "impl/robinhood.h"
+
+/* a key that is already present gets the insertion's value, and its old value is returned */
+static void *robinhood_put(hashmap_ds *const this, hashmap_entry insertion, int unique) {
+	void *oldval;
+	size_t i = robinhood_insert(this, insertion, insertion.hash, unique);
+	if (i == this->capacity) return NULL;
+	
+	oldval = this->table[i].value;
+	COW_TOUCH(this, i);
+	this->table[i].value = insertion.value;
+	return oldval;
+}
+
+/* entries whose home is the given slot sit together, right where the probe sequence length matches the distance */
+static size_t robinhood_scan_bucket(hashmap_ds *const this, size_t bucket, void callback(hashmap_entry*, void*), void *context) {
+	size_t psl, dist, count = 0, mask = this->capacity - 1;
+	size_t i = bucket;
+	for (dist = 0; this->meta[i] != PSL_VACANT; i = (i+1) & mask, dist++) {
+		psl = robinhood_slot_psl(this, i);
+		if (psl < dist) break;
+		if (psl == dist) {
+			callback(&this->table[i], context);
+			count++;
+		}
+	}
+	return count;
+}
+
+/*** ROBIN-HOOD ENGINE - END ***/
+
+/*** SWISS ENGINE - BEGIN ***/
+
+/* bitmask of the slots in a group whose control byte equals the given one */
+static unsigned swiss_group_match(const unsigned char *group, unsigned char ctrl) {
+#ifdef __SSE2__
+	__m128i bytes = _mm_loadu_si128((const __m128i*)group);
+	return (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8((char)ctrl)));
+#else
+	unsigned i, mask = 0;
+	for (i = 0; i < GROUP_WIDTH; i++) {
+		if (group[i] == ctrl) mask |= 1u << i;
+	}
+	return mask;
+#endif
+}
+
+/* bitmask of the slots in a group that are either empty or deleted */
+static unsigned swiss_group_match_free(const unsigned char *group) {
+#ifdef __SSE2__
+	__m128i bytes = _mm_loadu_si128((const __m128i*)group);
+	return ~(unsigned)_mm_movemask_epi8(bytes) & 0xFFFF;
+#else
+	unsigned i, mask = 0;
+	for (i = 0; i < GROUP_WIDTH; i++) {
+		if (!(group[i] & CTRL_FULL)) mask |= 1u << i;
+	}
+	return mask;
+#endif
+}
+
+static unsigned swiss_lowest_bit(unsigned mask) {
+#ifdef __GNUC__
+	return (unsigned)__builtin_ctz(mask);
+#else
+	unsigned bit = 0;
+	while (!(mask & 1u)) {
+		mask >>= 1;
+		bit++;
+	}
+	return bit;
+#endif
+}
+
+/*
+ * Walks the groups in triangular order starting from the key's home group. The table always has empty slots
+ * left, and triangular steps visit every group of a power-of-two table, so the walk is guaranteed to end.
+ * Returns the slot holding the key, or the capacity of the table if the key is absent; in that case the first
+ * empty or deleted slot on the way is reported through vacancy (nullable).
+ */
+static size_t swiss_search(hashmap_ds *const this, const void *key, size_t hash, size_t *vacancy) {
+	size_t step = 0, group_mask = (this->capacity / GROUP_WIDTH) - 1;
+	size_t group = (hash & (this->capacity - 1)) / GROUP_WIDTH;
+	unsigned char fingerprint = CTRL_FINGERPRINT(hash);
+	
+	if (vacancy != NULL) *vacancy = this->capacity;
+	for (;;) {
+		const unsigned char *ctrl = this->meta + group * GROUP_WIDTH;
+		unsigned matches = swiss_group_match(ctrl, fingerprint);
+		
+		/* only fingerprint matches are worth an equality call */
+		while (matches != 0) {
+			size_t i = group * GROUP_WIDTH + swiss_lowest_bit(matches);
+			if (KEY_MATCHES(this, this->table[i], key, hash)) {
+				STATS_ADD(this, probes, step + 1);
+				return i;
+			}
+			matches &= matches - 1;
+		}
+		
+		if (vacancy != NULL && *vacancy == this->capacity) {
+			unsigned free_slots = swiss_group_match_free(ctrl);
+			if (free_slots != 0) *vacancy = group * GROUP_WIDTH + swiss_lowest_bit(free_slots);
+		}
+		
+		/* an empty slot means the key was never pushed past this group */
+		if (swiss_group_match(ctrl, CTRL_EMPTY) != 0) {
+			STATS_ADD(this, probes, step + 1);
+			return this->capacity;
+		}
+		group = (group + ++step) & group_mask;
+	}
+}
+
+/* amount of groups that were probed past before reaching the group of an occupied slot */
+static size_t swiss_slot_psl(hashmap_ds *const this, size_t i) {
+	size_t step = 0, group_mask = (this->capacity / GROUP_WIDTH) - 1;
+	size_t group = (this->table[i].hash & (this->capacity - 1)) / GROUP_WIDTH;
+	while (group != i / GROUP_WIDTH) {
+		group = (group + ++step) & group_mask;
+	}
+	return step;
+}
+
+/* first empty or deleted slot along the probe sequence of the given hash */
+static size_t swiss_vacancy(hashmap_ds *const this, size_t hash) {
+	size_t step = 0, group_mask = (this->capacity / GROUP_WIDTH) - 1;
+	size_t group = (hash & (this->capacity - 1)) / GROUP_WIDTH;
+	unsigned free_slots;
+	
+	while ((free_slots = swiss_group_match_free(this->meta + group * GROUP_WIDTH)) == 0) {
+		group = (group + ++step) & group_mask;
+	}
+	return group * GROUP_WIDTH + swiss_lowest_bit(free_slots);
+}
+
+/* a unique insertion is known to be absent from the table, so no key is compared */
+static void *swiss_put(hashmap_ds *const this, hashmap_entry insertion, int unique) {
+	size_t vacancy;
+	
+	if (unique) {
+		vacancy = swiss_vacancy(this, insertion.hash);
+	} else {
+		size_t i = swiss_search(this, insertion.key, insertion.hash, &vacancy);
+		if (i != this->capacity) {
+			void *oldval = this->table[i].value;
+			COW_TOUCH(this, i);
+			this->table[i].value = insertion.value;
+			return oldval;
+		}
+	}
+	
+	COW_TOUCH(this, vacancy);
+	if (this->meta[vacancy] == CTRL_DELETED) this->tombstones--;
+	this->meta[vacancy] = CTRL_FINGERPRINT(insertion.hash);
+	this->table[vacancy] = insertion;
+	this->size++;
+	return NULL;
+}
+
+static void swiss_erase(hashmap_ds *const this, size_t i) {
+	COW_TOUCH(this, i);
+	
+	/* a group that already stops lookups can take back an empty slot, otherwise a tombstone keeps probes going */
+	if (swiss_group_match(this->meta + (i & ~(size_t)(GROUP_WIDTH - 1)), CTRL_EMPTY) != 0) {
+		this->meta[i] = CTRL_EMPTY;
+	} else {
+		this->meta[i] = CTRL_DELETED;
+		this->tombstones++;
+	}
+}
+
+/* nothing moves when erasing from a swiss table, so a single pass just erases every doomed entry it comes across */
+static size_t swiss_compact(hashmap_ds *const this, int doomed(hashmap_ds*, size_t, void*), void *context) {
+	size_t i, removed = 0;
+	for (i = 0; i < this->capacity; i++) {
+		if ((this->meta[i] & CTRL_FULL) && doomed(this, i, context)) {
+			swiss_erase(this, i);
+			removed++;
+		}
+	}
+	return removed;
+}
+
+/* entries whose home is the given group are spread along its probe sequence, up to the first group with an empty slot */
+static size_t swiss_scan_bucket(hashmap_ds *const this, size_t bucket, void callback(hashmap_entry*, void*), void *context) {
+	size_t k, step = 0, count = 0, group_mask = (this->capacity / GROUP_WIDTH) - 1;
+	size_t group = bucket;
+	for (;;) {
+		const unsigned char *ctrl = this->meta + group * GROUP_WIDTH;
+		for (k = 0; k < GROUP_WIDTH; k++) {
+			size_t i = group * GROUP_WIDTH + k;
+			if ((ctrl[k] & CTRL_FULL) && (this->table[i].hash & (this->capacity - 1)) / GROUP_WIDTH == bucket) {
+				callback(&this->table[i], context);
+				count++;
+			}
+		}
+		
+		if (swiss_group_match(ctrl, CTRL_EMPTY) != 0) return count;
+		group = (group + ++step) & group_mask;
+	}
+}
+
+/*** SWISS ENGINE - END ***/
+
+/*** COPY-ON-WRITE SNAPSHOTS - BEGIN ***/
+
+/* called with the lock held: hands a copy of the chunk to every snapshot that still shares it */
+static void hashmap_cow_copy(hashmap_ds *const this, size_t c) {
+	hashmap_cow *cow = this->cow;
+	hashmap_snapshot_ds *snapshot;
+	hashmap_chunk *copy;
+	size_t sharers = 0, slots = this->capacity < CHUNK_SLOTS ? this->capacity : CHUNK_SLOTS;
+	
+	if (cow->stamps[c] == cow->generation) return;
+	for (snapshot = cow->snapshots; snapshot != NULL; snapshot = snapshot->next) {
+		if (snapshot->chunks[c] == NULL) sharers++;
+	}
+	
+	if (sharers != 0) {
+		/* malloc since readers may free the copy from any thread */
+		copy = malloc(sizeof *copy + slots * (sizeof *copy->table + sizeof *copy->meta));
+		DS_ASSERT(copy != NULL, "failed to allocate memory for a chunk of a snapshot");
+		
+		copy->refs = sharers;
+		copy->table = (hashmap_entry*)(copy + 1);
+		copy->meta = (unsigned char*)(copy->table + slots);
+		memcpy(copy->table, this->table + (c << CHUNK_SHIFT), slots * sizeof *copy->table);
+		memcpy(copy->meta, this->meta + (c << CHUNK_SHIFT), slots * sizeof *copy->meta);
+		for (snapshot = cow->snapshots; snapshot != NULL; snapshot = snapshot->next) {
+			if (snapshot->chunks[c] == NULL) __atomic_store_n(&snapshot->chunks[c], copy, __ATOMIC_RELEASE);
+		}
+	}
+	__atomic_store_n(&cow->stamps[c], cow->generation, __ATOMIC_RELEASE);
+}
+
+/* only chunks that haven't been copied since the latest snapshot was taken need the lock */
+static void hashmap_cow_touch(hashmap_ds *const this, size_t c) {
+	hashmap_cow *cow = this->cow;
+	if (cow->stamps == NULL || __atomic_load_n(&cow->stamps[c], __ATOMIC_ACQUIRE) == cow->generation) return;
+	
+	pthread_mutex_lock(&cow->lock);
+	hashmap_cow_copy(this, c);
+	pthread_mutex_unlock(&cow->lock);
+}
+
+/*
+ * Copies every chunk that snapshots still share, the table is about to be replaced or freed. The snapshots
+ * then no longer need the hashmap and leave the list, whose chunk indices only apply to the current table.
+ */
+static void hashmap_unshare(hashmap_ds *const this) {
+	hashmap_snapshot_ds *snapshot;
+	size_t c;
+	if (this->cow == NULL || this->cow->stamps == NULL) return;
+	
+	pthread_mutex_lock(&this->cow->lock);
+	for (c = 0; c < CHUNK_COUNT(this->capacity); c++) {
+		hashmap_cow_copy(this, c);
+	}
+	for (snapshot = this->cow->snapshots; snapshot != NULL; snapshot = snapshot->next) {
+		snapshot->map = NULL;
+	}
+	this->cow->snapshots = NULL;
+	ds_free(&this->allocator, this->cow->stamps, CHUNK_COUNT(this->capacity) * sizeof *this->cow->stamps);
+	this->cow->stamps = NULL;
+	pthread_mutex_unlock(&this->cow->lock);
+}
+
+/* drops the hashmap's or a snapshot's hold on the cow, freeing it with the last one */
+static void hashmap_cow_release(hashmap_cow *const cow) {
+	size_t refs;
+	pthread_mutex_lock(&cow->lock);
+	refs = --cow->refs;
+	pthread_mutex_unlock(&cow->lock);
+	
+	if (refs == 0) {
+		pthread_mutex_destroy(&cow->lock);
+		free(cow);
+	}
+}
+
+/* a chunk the writer hasn't copied yet is copied by the reader instead, the writer can't modify it meanwhile */
+static hashmap_chunk *hashmap_snapshot_chunk(hashmap_snapshot_ds *const snapshot, size_t c) {
+	hashmap_chunk *chunk = __atomic_load_n(&snapshot->chunks[c], __ATOMIC_ACQUIRE);
+	if (chunk == NULL) {
+		pthread_mutex_lock(&snapshot->cow->lock);
+		if (snapshot->chunks[c] == NULL) hashmap_cow_copy(snapshot->map, c);
+		pthread_mutex_unlock(&snapshot->cow->lock);
+		chunk = snapshot->chunks[c];
+	}
+	return chunk;
+}
+
+static hashmap_entry *robinhood_snapshot_search(hashmap_snapshot_ds *const snapshot, const void *key, size_t hash) {
+	size_t dist, mask = snapshot->capacity - 1;
+	size_t i = hash & mask;
+	
+	for (dist = 0;; i = (i+1) & mask, dist++) {
+		hashmap_chunk *chunk = hashmap_snapshot_chunk(snapshot, i >> CHUNK_SHIFT);
+		size_t j = i & (snapshot->chunk_slots - 1);
+		unsigned char psl = chunk->meta[j];
+		
+		if (psl == PSL_VACANT || (psl != PSL_SATURATED && (size_t)(psl - 1) < dist)) return NULL;
+		if (chunk->table[j].hash == hash && snapshot->is_equals(chunk->table[j].key, key)) return &chunk->table[j];
+	}
+}
+
+/* groups never straddle two chunks, since chunks hold a whole number of them */
+static hashmap_entry *swiss_snapshot_search(hashmap_snapshot_ds *const snapshot, const void *key, size_t hash) {
+	size_t step = 0, group_mask = (snapshot->capacity / GROUP_WIDTH) - 1;
+	size_t group = (hash & (snapshot->capacity - 1)) / GROUP_WIDTH;
+	unsigned char fingerprint = CTRL_FINGERPRINT(hash);
+	
+	for (;;) {
+		hashmap_chunk *chunk = hashmap_snapshot_chunk(snapshot, (group * GROUP_WIDTH) >> CHUNK_SHIFT);
+		size_t first = (group * GROUP_WIDTH) & (snapshot->chunk_slots - 1);
+		unsigned matches = swiss_group_match(chunk->meta + first, fingerprint);
+		
+		while (matches != 0) {
+			hashmap_entry *entry = &chunk->table[first + swiss_lowest_bit(matches)];
+			if (entry->hash == hash && snapshot->is_equals(entry->key, key)) return entry;
+			matches &= matches - 1;
+		}
+		if (swiss_group_match(chunk->meta + first, CTRL_EMPTY) != 0) return NULL;
+		group = (group + ++step) & group_mask;
+	}
+}
+
+/*** COPY-ON-WRITE SNAPSHOTS - END ***/
+
+static size_t hashmap_search(hashmap_ds *const this, const void *key, size_t hash) {
+	return this->engine == HASHMAP_SWISS ? swiss_search(this, key, hash, NULL) : robinhood_search(this, key, hash);
+}
+
+/* puts into the table without checking the load factor */
+static void *hashmap_place(hashmap_ds *const this, hashmap_entry insertion, int unique) {
+	return this->engine == HASHMAP_SWISS ? swiss_put(this, insertion, unique) : robinhood_put(this, insertion, unique);
+}
+
+/* erases every entry the given function dooms, it's called once per entry with the slot the entry started out in */
+static size_t hashmap_compact(hashmap_ds *const this, int doomed(hashmap_ds*, size_t, void*), void *context) {
+	size_t removed = this->engine == HASHMAP_SWISS ? swiss_compact(this, doomed, context) : robinhood_compact(this, doomed, context);
+	this->size -= removed;
+	return removed;
+}
+
+/* the scan walks home buckets: slots for robin-hood probing, groups for swiss probing */
+static size_t hashmap_scan_mask(hashmap_ds *const this) {
+	return (this->engine == HASHMAP_SWISS ? this->capacity / GROUP_WIDTH : this->capacity) - 1;
+}
+
+static size_t hashmap_scan_bucket(hashmap_ds *const this, size_t bucket, void callback(hashmap_entry*, void*), void *context) {
+	return this->engine == HASHMAP_SWISS ? swiss_scan_bucket(this, bucket, callback, context) : robinhood_scan_bucket(this, bucket, callback, context);
+}
+
+static void hashmap_erase(hashmap_ds *const this, size_t i) {
+	if (this->engine == HASHMAP_SWISS) {
+		swiss_erase(this, i);
+	} else {
+		robinhood_erase(this, i);
+	}
+	this->size--;
+}
+
+static size_t hashmap_count(hashmap_ds *const this) {
+	return this->rehashing != NULL ? this->size + this->rehashing->size : this->size;
+}
+
+/*
+ * Moves entries of the old table over to the new one, visiting at most the given amount of slots. The old
+ * table is walked backwards from one of its vacant slots, so every entry that is erased has nothing left
+ * behind it to shift back, and the entries that remain are still reachable by a plain search.
+ */
+static void hashmap_migrate(hashmap_ds *const this, size_t slots) {
+	hashmap_ds *old = this->rehashing;
+	size_t mask = old->capacity - 1;
+	double start = this->stats != NULL ? hashmap_now() : 0.0;
+	
+	for (; slots > 0 && old->size > 0; slots--) {
+		this->rehash_cursor = (this->rehash_cursor - 1) & mask;
+		if (SLOT_OCCUPIED(old, this->rehash_cursor)) {
+			hashmap_place(this, old->table[this->rehash_cursor], 1);
+			hashmap_erase(old, this->rehash_cursor);
+		}
+	}
+	
+	if (old->size == 0) {
+		hashmap_free_table(old);
+		ds_free(&this->allocator, old, sizeof *old);
+		this->rehashing = NULL;
+	}
+	STATS_ADD(this, rehash_seconds, hashmap_now() - start);
+}
+
+/*** PARALLEL BUILD - BEGIN ***/
+
+/*
+ * A build puts every entry into a table of its final capacity at once. The table is cut into one range of
+ * slots per thread, and each thread only ever writes the range that the home slots of its entries fall into:
+ * entries are first hashed in parallel, then sorted by range (keeping their order within a range), and then
+ * each thread puts its entries with robin-hood insertion that stops at the end of its range rather than
+ * wrapping. Whatever would spill over into the next range is deferred and put afterwards by a single thread.
+ * Those spills are rare since the table isn't more than 3/4 full, and they're put latest first, skipping any
+ * key that is present already: a key put into a range is always more recent than its deferred duplicates.
+ */
+typedef struct hashmap_build_job {
+	hashmap_ds *map;
+	hashmap_entry *pending;		/* existing entries, followed by the pairs to put */
+	size_t existing;
+	size_t total;
+	void *const *keys;
+	void *const *values;
+	size_t *order;				/* pending entries sorted by range */
+	size_t *counts;				/* pending entries per chunk per range, then where each chunk's entries go */
+	size_t *range_starts;		/* where each range's entries start in order */
+	size_t threads;
+	size_t range_shift;
+	size_t chunk;
+} hashmap_build_job;
+
+typedef struct hashmap_build_worker {
+	pthread_t thread;
+	hashmap_build_job *job;
+	size_t index;
+	size_t placed;
+	hashmap_entry *deferred;
+	size_t deferred_count;
+	size_t deferred_capacity;
+} hashmap_build_worker;
+
+static void hashmap_build_defer(hashmap_build_worker *const worker, hashmap_entry entry) {
+	if (worker->deferred_count == worker->deferred_capacity) {
+		/* malloc since the hashmap's allocator may not be safe to call from several threads */
+		worker->deferred_capacity = worker->deferred_capacity != 0 ? worker->deferred_capacity << 1 : 64;
+		worker->deferred = realloc(worker->deferred, worker->deferred_capacity * sizeof *worker->deferred);
+		DS_ASSERT(worker->deferred != NULL, "failed to allocate memory for the entries deferred by a build");
+	}
+	worker->deferred[worker->deferred_count++] = entry;
+}
+
+/* robin-hood insertion confined to the slots before end, bypassing the instrumentation that isn't thread-safe */
+static void hashmap_build_place(hashmap_build_worker *const worker, hashmap_entry insertion, size_t end, int unique) {
+	hashmap_ds *this = worker->job->map;
+	int displaced = unique;
+	size_t dist, occupant_dist, i = insertion.hash & (this->capacity - 1);
+	
+	for (dist = 0; i < end; i++, dist++) {
+		if (this->meta[i] == PSL_VACANT) {
+			this->table[i] = insertion;
+			this->meta[i] = PSL_BYTE(dist);
+			worker->placed++;
+			return;
+		}
+		if (!displaced && this->table[i].hash == insertion.hash && this->is_equals(this->table[i].key, insertion.key)) {
+			this->table[i].value = insertion.value;
+			return;
+		}
+		
+		occupant_dist = robinhood_slot_psl(this, i);
+		if (dist > occupant_dist) {
+			/* swap */
+			hashmap_entry temp = this->table[i];
+			this->table[i] = insertion;
+			this->meta[i] = PSL_BYTE(dist);
+			
+			/* find new spot */
+			insertion = temp;
+			dist = occupant_dist;
+			displaced = 1;
+		}
+	}
+	hashmap_build_defer(worker, insertion);
+}
+
+static void *hashmap_build_hash(void *arg) {
+	hashmap_build_worker *worker = arg;
+	hashmap_build_job *job = worker->job;
+	hashmap_ds *this = job->map;
+	size_t i, from = worker->index * job->chunk, to = from + job->chunk < job->total ? from + job->chunk : job->total;
+	size_t *counts = job->counts + worker->index * job->threads;
+	
+	for (i = from; i < to; i++) {
+		hashmap_entry *entry = &job->pending[i];
+		if (i >= job->existing) {
+			entry->key = job->keys[i - job->existing];
+			entry->value = job->values[i - job->existing];
+			entry->hash = this->hash64 != NULL ? this->hash64(entry->key) : (size_t)(unsigned)this->hash(entry->key);
+		}
+		counts[(entry->hash & (this->capacity - 1)) >> job->range_shift]++;
+	}
+	return NULL;
+}
+
+static void *hashmap_build_sort(void *arg) {
+	hashmap_build_worker *worker = arg;
+	hashmap_build_job *job = worker->job;
+	size_t i, from = worker->index * job->chunk, to = from + job->chunk < job->total ? from + job->chunk : job->total;
+	size_t *offsets = job->counts + worker->index * job->threads;
+	
+	for (i = from; i < to; i++) {
+		job->order[offsets[(job->pending[i].hash & (job->map->capacity - 1)) >> job->range_shift]++] = i;
+	}
+	return NULL;
+}
+
+static void *hashmap_build_insert(void *arg) {
+	hashmap_build_worker *worker = arg;
+	hashmap_build_job *job = worker->job;
+	size_t j, from = job->range_starts[worker->index], to = job->range_starts[worker->index + 1];
+	size_t end = (worker->index + 1) << job->range_shift;
+	
+	for (j = from; j < to; j++) {
+		if (j + BATCH_WIDTH < to) PREFETCH(&job->pending[job->order[j + BATCH_WIDTH]]);
+		hashmap_build_place(worker, job->pending[job->order[j]], end, job->order[j] < job->existing);
+	}
+	return NULL;
+}
+
+static void hashmap_build_run(hashmap_build_worker *const workers, size_t threads, void *run(void*)) {
+	size_t t;
+	for (t = 1; t < threads; t++) {
+		DS_ASSERT(pthread_create(&workers[t].thread, NULL, run, &workers[t]) == 0, "failed to start a thread for the build");
+	}
+	run(&workers[0]);
+	for (t = 1; t < threads; t++) {
+		pthread_join(workers[t].thread, NULL);
+	}
+}
+
+/*
+ * Replaces the table with an empty one of the given capacity, then puts the entries it had followed by the given
+ * pairs. Swiss tables have no ranges to split, their pairs are only hashed in parallel and then put in order.
+ */
+static void hashmap_rebuild(hashmap_ds *const this, size_t capacity, void *const *keys, void *const *values, size_t n, size_t threads) {
+	size_t i, t, r, existing = 0, running = 0;
+	hashmap_build_job job;
+	hashmap_build_worker *workers;
+	
+	if (this->rehashing != NULL) hashmap_migrate(this, this->rehashing->capacity);
+	
+	/* one range per thread, a power of two of them so that ranges are picked by shifting */
+	for (job.range_shift = 0; ((size_t)1 << job.range_shift) < capacity; job.range_shift++);
+	for (job.threads = 1; job.threads << 1 <= threads && capacity / (job.threads << 1) >= BUILD_MIN_RANGE; job.threads <<= 1) {
+		job.range_shift--;
+	}
+	
+	job.map = this;
+	job.existing = this->size;
+	job.total = this->size + n;
+	job.keys = keys;
+	job.values = values;
+	job.chunk = (job.total + job.threads - 1) / job.threads;
+	job.pending = ds_alloc(&this->allocator, job.total * sizeof *job.pending);
+	job.order = ds_alloc(&this->allocator, job.total * sizeof *job.order);
+	job.counts = ds_alloc(&this->allocator, job.threads * job.threads * sizeof *job.counts);
+	job.range_starts = ds_alloc(&this->allocator, (job.threads + 1) * sizeof *job.range_starts);
+	workers = ds_alloc(&this->allocator, job.threads * sizeof *workers);
+	DS_ASSERT(job.pending != NULL && job.order != NULL && job.counts != NULL && job.range_starts != NULL && workers != NULL,
+		"failed to allocate memory for building the " DS_NAME);
+	memset(job.counts, 0, job.threads * job.threads * sizeof *job.counts);
+	memset(workers, 0, job.threads * sizeof *workers);
+	
+	for (i = 0; i < this->capacity; i++) {
+		if (SLOT_OCCUPIED(this, i)) job.pending[existing++] = this->table[i];
+	}
+	hashmap_free_table(this);
+	hashmap_alloc_table(this, capacity);
+	
+	for (t = 0; t < job.threads; t++) {
+		workers[t].job = &job;
+		workers[t].index = t;
+	}
+	hashmap_build_run(workers, job.threads, hashmap_build_hash);
+	STATS_ADD(this, hash_calls, n);
+	
+	if (this->engine == HASHMAP_SWISS) {
+		for (i = 0; i < job.total; i++) {
+			hashmap_place(this, job.pending[i], i < job.existing);
+		}
+	} else {
+		/* every range's entries start after the previous range's, and within a range chunks keep their order */
+		for (r = 0; r < job.threads; r++) {
+			job.range_starts[r] = running;
+			for (t = 0; t < job.threads; t++) {
+				size_t count = job.counts[t * job.threads + r];
+				job.counts[t * job.threads + r] = running;
+				running += count;
+			}
+		}
+		job.range_starts[job.threads] = running;
+		
+		hashmap_build_run(workers, job.threads, hashmap_build_sort);
+		hashmap_build_run(workers, job.threads, hashmap_build_insert);
+		
+		for (t = 0; t < job.threads; t++) {
+			this->size += workers[t].placed;
+		}
+		for (t = 0; t < job.threads; t++) {
+			for (i = workers[t].deferred_count; i-- > 0;) {
+				hashmap_entry *entry = &workers[t].deferred[i];
+				if (hashmap_search(this, entry->key, entry->hash) == this->capacity) hashmap_place(this, *entry, 1);
+			}
+			free(workers[t].deferred);
+		}
+	}
+	
+	ds_free(&this->allocator, job.pending, job.total * sizeof *job.pending);
+	ds_free(&this->allocator, job.order, job.total * sizeof *job.order);
+	ds_free(&this->allocator, job.counts, job.threads * job.threads * sizeof *job.counts);
+	ds_free(&this->allocator, job.range_starts, (job.threads + 1) * sizeof *job.range_starts);
+	ds_free(&this->allocator, workers, job.threads * sizeof *workers);
+}
+
+/*** PARALLEL BUILD - END ***/
+
 static void hashmap_rehash(hashmap_ds *const this) {
 	size_t i;
-	
-	/* initialize all values of the temporary hashmap */
+	double start = this->stats != NULL ? hashmap_now() : 0.0;
 	hashmap_ds temp;
+	
+	/* snapshots can't follow entries into the new table, whatever they still share is copied for them first */
+	hashmap_unshare(this);
+	
+	/* large tables that are rehashed all at once can split the work across threads instead */
+	if (this->rehash_step == 0 && this->rehash_threads > 1 && this->engine == HASHMAP_ROBINHOOD && this->size >= BUILD_MIN_REHASH) {
+		STATS_ADD(this, rehashes, 1);
+		hashmap_rebuild(this, this->capacity << 1, NULL, NULL, 0, this->rehash_threads);
+		STATS_ADD(this, rehash_seconds, hashmap_now() - start);
+		return;
+	}
+	
+	/* initialize all values of the temporary hashmap, tombstones alone are cleared without growing */
 	temp.hash = this->hash;
+	temp.hash64 = this->hash64;
 	temp.is_equals = this->is_equals;
-	temp.size = 0;
-	temp.capacity = this->capacity << 1;
-	temp.load_factor = (temp.capacity * 3) >> 2;
-	temp.table = malloc(temp.capacity * sizeof *temp.table);
-	DS_ASSERT(temp.table != NULL, "failed to allocate memory for rehashed table");
+	temp.engine = this->engine;
+	temp.rehash_step = this->rehash_step;
+	temp.rehash_threads = this->rehash_threads;
+	temp.rehashing = NULL;
+	temp.stats = this->stats;
+	temp.mapping = NULL;
+	temp.cow = NULL;
+	temp.allocator = this->allocator;
+	hashmap_alloc_table(&temp, this->size << 1 >= this->load_factor ? this->capacity << 1 : this->capacity);
+	
+	STATS_ADD(this, rehashes, 1);
 	
-	for (i = 0; i < temp.capacity; i++) {
-		temp.table[i] = NULL;
+	/* a growing table can keep the old one around and migrate it a few slots per operation */
+	if (this->rehash_step != 0 && temp.capacity != this->capacity) {
+		hashmap_ds *old = ds_alloc(&this->allocator, sizeof *old);
+		DS_ASSERT(old != NULL, "failed to allocate memory for the table being rehashed");
+		
+		*old = *this;
+		*this = temp;
+		this->rehashing = old;
+		this->cow = old->cow;
+		old->cow = NULL;
+		for (this->rehash_cursor = 0; old->meta[this->rehash_cursor] != PSL_VACANT; this->rehash_cursor++);
+		STATS_ADD(this, rehash_seconds, hashmap_now() - start);
+		return;
 	}
 	
 	/* put all pairs from the hashmap's old table */
 	for (i = 0; i < this->capacity; i++) {
-		if (this->table[i] != NULL) {
-			hashmap_put(&temp, this->table[i]->key, this->table[i]->value);
-			free(this->table[i]);
+		if (SLOT_OCCUPIED(this, i)) {
+			hashmap_place(&temp, this->table[i], 1);
 		}
 	}
 	
 	/* only things we need to change are capacity, load factor, and the new table */
+	hashmap_free_table(this);
+	this->tombstones = 0;
 	this->capacity = temp.capacity;
 	this->load_factor = temp.load_factor;
-	free(this->table);
 	this->table = temp.table;
+	this->meta = temp.meta;
+	STATS_ADD(this, rehash_seconds, hashmap_now() - start);
 }
 
-static hashmap_entry **hashmap_search(hashmap_ds *const this, void *key) {
-	size_t mask = this->capacity - 1;
-	size_t i = ((size_t)absval(this->hash(key))) & mask;
-	for (; this->table[i] != NULL; i = (i+1) & mask) {
-		if (this->is_equals(this->table[i]->key, key)) {
-			break;
+hashmap_snapshot_ds *hashmap_snapshot(hashmap_ds *const this) {
+	hashmap_snapshot_ds *snapshot = malloc(sizeof *snapshot);
+	DS_ASSERT(snapshot != NULL, "failed to allocate memory for a snapshot of the " DS_NAME);
+	
+	/* snapshots only share a single table */
+	if (this->rehashing != NULL) hashmap_migrate(this, this->rehashing->capacity);
+	if (this->cow == NULL) {
+		/* malloc since the last snapshot may free it from any thread, after the hashmap is gone */
+		this->cow = malloc(sizeof *this->cow);
+		DS_ASSERT(this->cow != NULL, "failed to allocate memory for the " DS_NAME "'s snapshots");
+		DS_ASSERT(pthread_mutex_init(&this->cow->lock, NULL) == 0, "failed to initialize the lock of the " DS_NAME "'s snapshots");
+		this->cow->snapshots = NULL;
+		this->cow->generation = 0;
+		this->cow->stamps = NULL;
+		this->cow->refs = 1;
+	}
+	
+	snapshot->map = this;
+	snapshot->cow = this->cow;
+	snapshot->hash = this->hash;
+	snapshot->hash64 = this->hash64;
+	snapshot->is_equals = this->is_equals;
+	snapshot->engine = this->engine;
+	snapshot->size = this->size;
+	snapshot->capacity = this->capacity;
+	snapshot->chunk_slots = this->capacity < CHUNK_SLOTS ? this->capacity : CHUNK_SLOTS;
+	snapshot->chunks = calloc(CHUNK_COUNT(this->capacity), sizeof *snapshot->chunks);
+	DS_ASSERT(snapshot->chunks != NULL, "failed to allocate memory for a snapshot of the " DS_NAME);
+	
+	pthread_mutex_lock(&this->cow->lock);
+	if (this->cow->stamps == NULL) {
+		this->cow->stamps = ds_alloc(&this->allocator, CHUNK_COUNT(this->capacity) * sizeof *this->cow->stamps);
+		DS_ASSERT(this->cow->stamps != NULL, "failed to allocate memory for the " DS_NAME "'s snapshots");
+		memset(this->cow->stamps, 0, CHUNK_COUNT(this->capacity) * sizeof *this->cow->stamps);
+	}
+	
+	/* every chunk is now behind the generation, hence shared with the new snapshot */
+	this->cow->generation++;
+	this->cow->refs++;
+	snapshot->next = this->cow->snapshots;
+	this->cow->snapshots = snapshot;
+	pthread_mutex_unlock(&this->cow->lock);
+	return snapshot;
+}
+
+void hashmap_snapshot_release(hashmap_snapshot_ds *const snapshot) {
+	hashmap_snapshot_ds **link;
+	size_t c;
+	
+	/* the hashmap may be rehashing or deallocating meanwhile, which detaches the snapshot under the lock */
+	pthread_mutex_lock(&snapshot->cow->lock);
+	if (snapshot->map != NULL) {
+		for (link = &snapshot->cow->snapshots; *link != snapshot; link = &(*link)->next);
+		*link = snapshot->next;
+		snapshot->map = NULL;
+	}
+	pthread_mutex_unlock(&snapshot->cow->lock);
+	hashmap_cow_release(snapshot->cow);
+	
+	/* the writer can no longer hand out copies to this snapshot, the ones it has are dropped */
+	for (c = 0; c < CHUNK_COUNT(snapshot->capacity); c++) {
+		hashmap_chunk *chunk = snapshot->chunks[c];
+		if (chunk != NULL && __atomic_sub_fetch(&chunk->refs, 1, __ATOMIC_ACQ_REL) == 0) free(chunk);
+	}
+	free(snapshot->chunks);
+	free(snapshot);
+}
+
+void *hashmap_snapshot_get(hashmap_snapshot_ds *const snapshot, void *key) {
+	size_t hash = snapshot->hash64 != NULL ? snapshot->hash64(key) : (size_t)(unsigned)snapshot->hash(key);
+	hashmap_entry *entry = snapshot->engine == HASHMAP_SWISS ? swiss_snapshot_search(snapshot, key, hash) : robinhood_snapshot_search(snapshot, key, hash);
+	return entry != NULL ? entry->value : NULL;
+}
+
+size_t hashmap_snapshot_size(hashmap_snapshot_ds *const snapshot) {
+	return snapshot->size;
+}
+
+hashmap_entry *hashmap_snapshot_next(hashmap_snapshot_ds *const snapshot, size_t *slot) {
+	for (; *slot < snapshot->capacity; (*slot)++) {
+		hashmap_chunk *chunk = hashmap_snapshot_chunk(snapshot, *slot >> CHUNK_SHIFT);
+		size_t j = *slot & (snapshot->chunk_slots - 1);
+		
+		if (snapshot->engine == HASHMAP_SWISS ? (chunk->meta[j] & CTRL_FULL) != 0 : chunk->meta[j] != PSL_VACANT) {
+			(*slot)++;
+			return &chunk->table[j];
 		}
 	}
-	return &this->table[i];
+	return NULL;
 }
 
-void *hashmap_put(hashmap_ds *const this, void *key, void *value) {
-	size_t mask = this->capacity - 1;
-	size_t i = ((size_t)absval(this->hash(key))) % this->capacity;
-	hashmap_entry *insertion = malloc(sizeof *insertion);
-	DS_ASSERT(insertion != NULL, "failed to allocate memory for a new table entry");
-	
-	insertion->key = key;
-	insertion->value = value;
-	for (insertion->psl = 0; this->table[i] != NULL; i = (i+1) & mask, insertion->psl++) {
-		if (this->is_equals(this->table[i]->key, key)) {
-			void *oldval = this->table[i]->value;
-			this->table[i]->value = value;
-			free(insertion);
+void hashmap_set_rehash_threads(hashmap_ds *const this, size_t threads) {
+	this->rehash_threads = threads != 0 ? threads : 1;
+}
+
+void hashmap_set_rehash_step(hashmap_ds *const this, size_t slots) {
+	this->rehash_step = slots;
+	if (slots == 0 && this->rehashing != NULL) {
+		hashmap_migrate(this, this->rehashing->capacity);
+	}
+}
+
+static void *hashmap_put_hashed(hashmap_ds *const this, hashmap_entry insertion) {
+	void *oldval;
+	size_t size = this->size;
+	DS_ASSERT(this->mapping == NULL, "cannot put into a " DS_NAME " loaded from a snapshot");
+	
+	if (this->rehashing != NULL) {
+		size_t i;
+		hashmap_migrate(this, this->rehash_step);
+		
+		/* keys that haven't been migrated yet are updated in place */
+		if (this->rehashing != NULL && (i = hashmap_search(this->rehashing, insertion.key, insertion.hash)) != this->rehashing->capacity) {
+			oldval = this->rehashing->table[i].value;
+			this->rehashing->table[i].value = insertion.value;
 			return oldval;
-		} else if (insertion->psl > this->table[i]->psl) {
-			/* swap */
-			hashmap_entry *temp = this->table[i];
-			this->table[i] = insertion;
-			
-			/* find new spot */
-			insertion = temp;
 		}
 	}
 	
-	this->table[i] = insertion;
-	if (++this->size >= this->load_factor) hashmap_rehash(this);
-	return NULL;
+	oldval = hashmap_place(this, insertion, 0);
+	if (this->size != size && this->size + this->tombstones >= this->load_factor) {
+		/* only a tiny rehash step lets the new table fill up before the old one is drained */
+		if (this->rehashing != NULL) hashmap_migrate(this, this->rehashing->capacity);
+		hashmap_rehash(this);
+	}
+	return oldval;
+}
+
+void *hashmap_put(hashmap_ds *const this, void *key, void *value) {
+	hashmap_entry insertion;
+	insertion.key = key;
+	insertion.value = value;
+	insertion.hash = hashmap_hashof(this, key);
+	return hashmap_put_hashed(this, insertion);
+}
+
+/* looks up both tables while rehashing, returning the table holding the key and its slot through i */
+static hashmap_ds *hashmap_locate(hashmap_ds *const this, const void *key, size_t hash, size_t *i) {
+	hashmap_ds *table;
+	if (this->rehashing != NULL) hashmap_migrate(this, this->rehash_step);
+	if (this->stats != NULL) this->stats->probes = 0;
+	
+	if (this->rehashing == NULL || (*i = hashmap_search(this->rehashing, key, hash)) == this->rehashing->capacity) {
+		table = (*i = hashmap_search(this, key, hash)) != this->capacity ? this : NULL;
+	} else {
+		table = this->rehashing;
+	}
+	
+	if (this->stats != NULL) {
+		if (table != NULL) {
+			this->stats->hits++;
+			this->stats->hit_probes += this->stats->probes;
+		} else {
+			this->stats->misses++;
+			this->stats->miss_probes += this->stats->probes;
+		}
+	}
+	return table;
 }
 
 void *hashmap_get(hashmap_ds *const this, void *key) {
-	hashmap_entry **entryref = hashmap_search(this, key);
-	return *entryref != NULL ? (*entryref)->value : NULL;
+	size_t i;
+	hashmap_ds *table = hashmap_locate(this, key, hashmap_hashof(this, key), &i);
+	return table != NULL ? table->table[i].value : NULL;
 }
 
 void *hashmap_get_keyref(hashmap_ds *const this, void *key) {
-	hashmap_entry **entryref = hashmap_search(this, key);
-	return *entryref != NULL ? (*entryref)->key : NULL;
+	size_t i;
+	hashmap_ds *table = hashmap_locate(this, key, hashmap_hashof(this, key), &i);
+	return table != NULL ? table->table[i].key : NULL;
 }
 
 void *hashmap_remove(hashmap_ds *const this, void *key) {
 	void *oldval = NULL;
-	hashmap_entry **entryref = hashmap_search(this, key);
+	size_t i;
+	hashmap_ds *table;
+	DS_ASSERT(this->mapping == NULL, "cannot remove from a " DS_NAME " loaded from a snapshot");
 	
-	if (*entryref != NULL) {
-		size_t i, mask = this->capacity - 1;
-		
-		oldval = (*entryref)->value;
-		free(*entryref);
-		*entryref = NULL;
+	table = hashmap_locate(this, key, hashmap_hashof(this, key), &i);
+	if (table != NULL) {
+		oldval = table->table[i].value;
+		hashmap_erase(table, i);
+	}
+	
+	return oldval;
+}
+
+/* pulls in the home slot of a hash ahead of its lookup, in both tables while rehashing */
+static void hashmap_prefetch(hashmap_ds *const this, size_t hash) {
+	size_t home = hash & (this->capacity - 1);
+	PREFETCH(this->meta + home);
+	PREFETCH(this->table + home);
+	if (this->rehashing != NULL) {
+		home = hash & (this->rehashing->capacity - 1);
+		PREFETCH(this->rehashing->meta + home);
+		PREFETCH(this->rehashing->table + home);
+	}
+}
+
+size_t hashmap_get_many(hashmap_ds *const this, void *const *keys, size_t n, void **out_values) {
+	size_t k, batch, i, found = 0;
+	size_t hashes[BATCH_WIDTH];
+	hashmap_ds *table;
+	
+	for (batch = 0; batch < n; batch += BATCH_WIDTH) {
+		size_t width = n - batch < BATCH_WIDTH ? n - batch : BATCH_WIDTH;
 		
-		/* engage backward shifting */
-		i = (((size_t)(entryref - this->table)) + 1) & mask;
-		for (; this->table[i] != NULL && this->table[i]->psl > 0; i = (i+1) & mask) {
-			this->table[i]->psl--;
-			
-			/* account for unsigned wraparound if any */
-			this->table[(i-1) & mask] = this->table[i];
-			this->table[i] = NULL;
+		/* hash the whole batch first so that the slots are already on their way while the probes run */
+		for (k = 0; k < width; k++) {
+			hashes[k] = hashmap_hashof(this, keys[batch + k]);
+			hashmap_prefetch(this, hashes[k]);
+		}
+		for (k = 0; k < width; k++) {
+			table = hashmap_locate(this, keys[batch + k], hashes[k], &i);
+			out_values[batch + k] = table != NULL ? table->table[i].value : NULL;
+			if (table != NULL) found++;
 		}
+	}
+	return found;
+}
+
+void hashmap_put_many(hashmap_ds *const this, void *const *keys, void *const *values, size_t n, void **out_oldvalues) {
+	size_t k, batch;
+	hashmap_entry insertions[BATCH_WIDTH];
+	void *oldval;
+	
+	for (batch = 0; batch < n; batch += BATCH_WIDTH) {
+		size_t width = n - batch < BATCH_WIDTH ? n - batch : BATCH_WIDTH;
 		
-		this->size--;
+		for (k = 0; k < width; k++) {
+			insertions[k].key = keys[batch + k];
+			insertions[k].value = values[batch + k];
+			insertions[k].hash = hashmap_hashof(this, keys[batch + k]);
+			hashmap_prefetch(this, insertions[k].hash);
+		}
+		for (k = 0; k < width; k++) {
+			oldval = hashmap_put_hashed(this, insertions[k]);
+			if (out_oldvalues != NULL) out_oldvalues[batch + k] = oldval;
+		}
 	}
+}
+
+void hashmap_build(hashmap_ds *const this, void *const *keys, void *const *values, size_t n, size_t threads) {
+	size_t capacity = INITIAL_CAPACITY, total = hashmap_count(this) + n;
+	DS_ASSERT(this->mapping == NULL, "cannot put into a " DS_NAME " loaded from a snapshot");
 	
-	return oldval;
+	/* the table is sized for every pair up front, duplicates and all, so that it never has to grow midway */
+	while (((capacity * 3) >> 2) <= total) {
+		capacity <<= 1;
+	}
+	if (hashmap_count(this) > 0) STATS_ADD(this, rehashes, 1);
+	hashmap_rebuild(this, capacity, keys, values, n, threads);
+}
+
+typedef struct hashmap_retain_context {
+	int (*predicate)(hashmap_entry*, void*);
+	void *context;
+} hashmap_retain_context;
+
+static int hashmap_retain_doomed(hashmap_ds *const table, size_t i, void *context) {
+	hashmap_retain_context *retain = context;
+	return !retain->predicate(&table->table[i], retain->context);
+}
+
+size_t hashmap_retain(hashmap_ds *const this, int predicate(hashmap_entry *entry, void *context), void *context) {
+	hashmap_retain_context retain;
+	DS_ASSERT(this->mapping == NULL, "cannot remove from a " DS_NAME " loaded from a snapshot");
+	
+	/* entries only have to be looked at once per table, a migration in progress is finished first */
+	if (this->rehashing != NULL) hashmap_migrate(this, this->rehashing->capacity);
+	
+	retain.predicate = predicate;
+	retain.context = context;
+	return hashmap_compact(this, hashmap_retain_doomed, &retain);
+}
+
+static int hashmap_marked_doomed(hashmap_ds *const table, size_t i, void *context) {
+	const unsigned char *marks = context;
+	(void)table;
+	return (marks[i / CHAR_BIT] >> (i % CHAR_BIT)) & 1;
+}
+
+size_t hashmap_remove_many(hashmap_ds *const this, void *const *keys, size_t n, void **out_oldvalues) {
+	size_t k, batch, i, removed = 0, hashes[BATCH_WIDTH];
+	size_t marks_size = (this->capacity + CHAR_BIT - 1) / CHAR_BIT;
+	unsigned char *marks;
+	DS_ASSERT(this->mapping == NULL, "cannot remove from a " DS_NAME " loaded from a snapshot");
+	
+	if (this->rehashing != NULL) hashmap_migrate(this, this->rehashing->capacity);
+	
+	/* a handful of keys isn't worth a pass over the whole table */
+	if (n < this->capacity / 8) {
+		size_t size = this->size;
+		for (k = 0; k < n; k++) {
+			void *oldval = hashmap_remove(this, keys[k]);
+			if (out_oldvalues != NULL) out_oldvalues[k] = oldval;
+		}
+		return size - this->size;
+	}
+	
+	marks = ds_alloc(&this->allocator, marks_size);
+	DS_ASSERT(marks != NULL, "failed to allocate memory for marking the entries to remove");
+	memset(marks, 0, marks_size);
+	
+	/* mark the slot of every key, keys that are missing or repeated have nothing (left) to remove */
+	for (batch = 0; batch < n; batch += BATCH_WIDTH) {
+		size_t width = n - batch < BATCH_WIDTH ? n - batch : BATCH_WIDTH;
+		for (k = 0; k < width; k++) {
+			hashes[k] = hashmap_hashof(this, keys[batch + k]);
+			hashmap_prefetch(this, hashes[k]);
+		}
+		for (k = 0; k < width; k++) {
+			void *oldval = NULL;
+			i = hashmap_search(this, keys[batch + k], hashes[k]);
+			if (i != this->capacity && !hashmap_marked_doomed(this, i, marks)) {
+				marks[i / CHAR_BIT] |= 1u << (i % CHAR_BIT);
+				oldval = this->table[i].value;
+				removed++;
+			}
+			if (out_oldvalues != NULL) out_oldvalues[batch + k] = oldval;
+		}
+	}
+	
+	if (removed != 0) hashmap_compact(this, hashmap_marked_doomed, marks);
+	ds_free(&this->allocator, marks, marks_size);
+	return removed;
+}
+
+void hashmap_set_stats(hashmap_ds *const this, int enabled) {
+	ds_free(&this->allocator, this->stats, sizeof *this->stats);
+	this->stats = NULL;
+	if (enabled) {
+		this->stats = ds_alloc(&this->allocator, sizeof *this->stats);
+		DS_ASSERT(this->stats != NULL, "failed to allocate memory for the " DS_NAME "'s counters");
+		memset(this->stats, 0, sizeof *this->stats);
+	}
+	if (this->rehashing != NULL) this->rehashing->stats = this->stats;
+}
+
+static void hashmap_tally_psls(hashmap_ds *const table, hashmap_stats *const stats) {
+	size_t i, psl;
+	for (i = 0; i < table->capacity; i++) {
+		if (SLOT_OCCUPIED(table, i)) {
+			psl = table->engine == HASHMAP_SWISS ? swiss_slot_psl(table, i) : robinhood_slot_psl(table, i);
+			stats->psl_histogram[psl < HASHMAP_PSL_BUCKETS - 1 ? psl : HASHMAP_PSL_BUCKETS - 1]++;
+			if (psl > stats->max_psl) stats->max_psl = psl;
+		}
+	}
+}
+
+void hashmap_getstats(hashmap_ds *const this, hashmap_stats *const stats) {
+	size_t i;
+	hashmap_counters none = {0};
+	hashmap_counters *counters = this->stats != NULL ? this->stats : &none;
+	
+	for (i = 0; i < HASHMAP_PSL_BUCKETS; i++) {
+		stats->psl_histogram[i] = 0;
+	}
+	stats->max_psl = 0;
+	hashmap_tally_psls(this, stats);
+	if (this->rehashing != NULL) hashmap_tally_psls(this->rehashing, stats);
+	
+	stats->hits = counters->hits;
+	stats->misses = counters->misses;
+	stats->probes_per_hit = counters->hits != 0 ? (double)counters->hit_probes / counters->hits : 0.0;
+	stats->probes_per_miss = counters->misses != 0 ? (double)counters->miss_probes / counters->misses : 0.0;
+	stats->equality_calls = counters->equality_calls;
+	stats->hash_calls = counters->hash_calls;
+	stats->rehashes = counters->rehashes;
+	stats->rehash_seconds = counters->rehash_seconds;
+}
+
+/* writes the bytes and pads them up to the next aligned offset, returns falsey on failure */
+static int snapshot_write(FILE *file, const void *bytes, size_t len, size_t *offset) {
+	static const char padding[SNAPSHOT_ALIGNMENT] = {0};
+	size_t aligned = SNAPSHOT_ALIGN(*offset + len);
+	if (len != 0 && fwrite(bytes, 1, len, file) != len) return 0;
+	if (aligned != *offset + len && fwrite(padding, 1, aligned - *offset - len, file) != aligned - *offset - len) return 0;
+	*offset = aligned;
+	return 1;
+}
+
+int hashmap_save(hashmap_ds *const this, const char *path, const void *key_bytes(const void *key, size_t *len), const void *value_bytes(const void *value, size_t *len)) {
+	int ok;
+	size_t i, len, offset = 0, payload_offset;
+	const void *bytes;
+	hashmap_snapshot_header header;
+	hashmap_entry relative;
+	FILE *file;
+	
+	/* a snapshot only ever holds one table */
+	if (this->rehashing != NULL) hashmap_migrate(this, this->rehashing->capacity);
+	
+	file = fopen(path, "wb");
+	if (file == NULL) return 0;
+	
+	memset(&header, 0, sizeof header);
+	memcpy(header.magic, SNAPSHOT_MAGIC, sizeof header.magic);
+	header.word_size = sizeof(size_t);
+	header.byte_order = 1;
+	header.engine = this->engine;
+	header.wide_hash = this->hash64 != NULL;
+	header.size = this->size;
+	header.tombstones = this->tombstones;
+	header.capacity = this->capacity;
+	ok = snapshot_write(file, &header, sizeof header, &offset);
+	ok = ok && snapshot_write(file, this->meta, this->capacity, &offset);
+	
+	/* entries point at payloads by their offset in the file, where NULL is offset 0 */
+	payload_offset = SNAPSHOT_ALIGN(offset + this->capacity * sizeof relative);
+	for (i = 0; ok && i < this->capacity; i++) {
+		memset(&relative, 0, sizeof relative);
+		if (SLOT_OCCUPIED(this, i)) {
+			if ((bytes = key_bytes(this->table[i].key, &len)) != NULL) {
+				relative.key = (void*)payload_offset;
+				payload_offset = SNAPSHOT_ALIGN(payload_offset + len);
+			}
+			if ((bytes = value_bytes(this->table[i].value, &len)) != NULL) {
+				relative.value = (void*)payload_offset;
+				payload_offset = SNAPSHOT_ALIGN(payload_offset + len);
+			}
+			relative.hash = this->table[i].hash;
+		}
+		ok = fwrite(&relative, sizeof relative, 1, file) == 1;
+	}
+	offset += this->capacity * sizeof relative;
+	ok = ok && snapshot_write(file, NULL, 0, &offset);
+	
+	/* payloads in the same order their offsets were handed out */
+	for (i = 0; ok && i < this->capacity; i++) {
+		if (SLOT_OCCUPIED(this, i)) {
+			if ((bytes = key_bytes(this->table[i].key, &len)) != NULL) ok = ok && snapshot_write(file, bytes, len, &offset);
+			if ((bytes = value_bytes(this->table[i].value, &len)) != NULL) ok = ok && snapshot_write(file, bytes, len, &offset);
+		}
+	}
+	
+	return fclose(file) == 0 && ok;
+}
+
+static hashmap_ds *hashmap_load_snapshot(const char *path, int hash(const void*), size_t hash64(const void*), int is_equals(const void*, const void*)) {
+	size_t i, length, meta_offset, table_offset;
+	struct stat status;
+	hashmap_snapshot_header *header;
+	hashmap_entry *table;
+	hashmap_ds *this;
+	char *mapping;
+	
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) return NULL;
+	if (fstat(fd, &status) != 0 || (size_t)status.st_size < sizeof *header) {
+		close(fd);
+		return NULL;
+	}
+	
+	/* a private mapping lets the table be patched in place while the payloads are never copied */
+	length = (size_t)status.st_size;
+	mapping = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED) return NULL;
+	
+	header = (hashmap_snapshot_header*)mapping;
+	meta_offset = SNAPSHOT_ALIGN(sizeof *header);
+	table_offset = SNAPSHOT_ALIGN(meta_offset + header->capacity);
+	if (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof header->magic) != 0 || header->word_size != sizeof(size_t) || header->byte_order != 1
+		|| (header->engine != HASHMAP_ROBINHOOD && header->engine != HASHMAP_SWISS)
+		|| header->wide_hash != (hash64 != NULL) || header->capacity < INITIAL_CAPACITY || (header->capacity & (header->capacity - 1)) != 0
+		|| header->capacity > length / sizeof *table || table_offset + header->capacity * sizeof *table > length) {
+		munmap(mapping, length);
+		return NULL;
+	}
+	
+	/* relocating offsets back into pointers is the only pass over the table, nothing is hashed or put again */
+	table = (hashmap_entry*)(mapping + table_offset);
+	for (i = 0; i < header->capacity; i++) {
+		if ((size_t)table[i].key >= length || (size_t)table[i].value >= length) {
+			munmap(mapping, length);
+			return NULL;
+		}
+		if (table[i].key != NULL) table[i].key = mapping + (size_t)table[i].key;
+		if (table[i].value != NULL) table[i].value = mapping + (size_t)table[i].value;
+	}
+	
+	this = alloc_hashmap64(hash64, is_equals, (hashmap_engine)header->engine);
+	hashmap_free_table(this);
+	this->hash = hash;
+	this->size = header->size;
+	this->tombstones = header->tombstones;
+	this->capacity = header->capacity;
+	this->load_factor = (header->capacity * 3) >> 2;
+	this->meta = (unsigned char*)(mapping + meta_offset);
+	this->table = table;
+	this->mapping = mapping;
+	this->mapping_length = length;
+	return this;
+}
+
+hashmap_ds *hashmap_load(const char *path, int hash(const void*), int is_equals(const void*, const void*)) {
+	return hashmap_load_snapshot(path, hash, NULL, is_equals);
+}
+
+hashmap_ds *hashmap_load64(const char *path, size_t hash(const void*), int is_equals(const void*, const void*)) {
+	return hashmap_load_snapshot(path, NULL, hash, is_equals);
+}
+
+/* increments the cursor with its bits reversed, so that buckets split by a growing table are visited right after each other */
+static size_t hashmap_scan_next(size_t cursor, size_t mask) {
+	size_t bit = (mask >> 1) + (mask != 0);
+	cursor &= mask;
+	while (bit != 0 && (cursor & bit)) {
+		cursor ^= bit;
+		bit >>= 1;
+	}
+	return cursor | bit;
+}
+
+size_t hashmap_scan(hashmap_ds *const this, size_t cursor, size_t batch, void callback(hashmap_entry *entry, void *context), void *context) {
+	size_t count = 0, visits = 0;
+	do {
+		if (this->rehashing == NULL) {
+			size_t mask = hashmap_scan_mask(this);
+			count += hashmap_scan_bucket(this, cursor & mask, callback, context);
+			cursor = hashmap_scan_next(cursor, mask);
+		} else {
+			/* visit the bucket in the smaller table, then every bucket of the larger table it was split into */
+			hashmap_ds *small = this->rehashing->capacity < this->capacity ? this->rehashing : this;
+			hashmap_ds *large = small == this ? this->rehashing : this;
+			size_t small_mask = hashmap_scan_mask(small), large_mask = hashmap_scan_mask(large);
+			
+			count += hashmap_scan_bucket(small, cursor & small_mask, callback, context);
+			do {
+				count += hashmap_scan_bucket(large, cursor & large_mask, callback, context);
+				cursor = (((cursor | small_mask) + 1) & ~small_mask) | (cursor & small_mask);
+			} while (cursor & (small_mask ^ large_mask));
+			cursor = hashmap_scan_next(cursor, small_mask);
+		}
+		
+		/* long stretches of empty buckets still end the call, even before the batch is full */
+	} while (cursor != 0 && count < batch && ++visits < batch * 10);
+	return cursor;
 }
 
 hashmap_entry **hashmap_getentries(hashmap_ds *const this) {
 	size_t i, capacity;
 	
 	/* allocate a list of entries + one more slot that indicates the end of a list using NULL*/
-	hashmap_entry **iteration, **entries = malloc((this->size+1) * sizeof *entries);
+	hashmap_entry **iteration, **entries = malloc((hashmap_count(this)+1) * sizeof *entries);
 	DS_ASSERT(entries != NULL, "failed to allocate a list of entries");
 	
-	entries[this->size] = NULL;
+	entries[hashmap_count(this)] = NULL;
 	iteration = entries;
 	for (i = 0, capacity = this->capacity; i < capacity; i++) {
-		if (this->table[i] != NULL) *iteration++ = this->table[i];
+		if (SLOT_OCCUPIED(this, i)) *iteration++ = &this->table[i];
+	}
+	if (this->rehashing != NULL) {
+		for (i = 0, capacity = this->rehashing->capacity; i < capacity; i++) {
+			if (SLOT_OCCUPIED(this->rehashing, i)) *iteration++ = &this->rehashing->table[i];
+		}
 	}
 	return entries;
 }
@@ -201,21 +1525,31 @@ hashmap_entry **hashmap_getentries(hashmap_ds *const this) {
 hashmap_ds_iterator hashmap_getiterator(hashmap_ds *const this) {
 	hashmap_ds_iterator itr;
 	itr.index = 0;
+	itr.slot = 0;
 	itr.map = this;
-	itr.entries = this->table;
 	return itr;
 }
 
 int hashmap_iterator_hasnext(hashmap_ds_iterator *const itr) {
-	return itr->index < itr->map->size;
+	return itr->index < hashmap_count(itr->map);
 }
 
 hashmap_entry *hashmap_iterator_next(hashmap_ds_iterator *const itr) {
-	hashmap_entry *entry = NULL;
+	size_t slot;
+	hashmap_ds *table;
 	if (!hashmap_iterator_hasnext(itr)) return NULL;
-	while (entry == NULL) {
-		entry = *itr->entries++;
+	
+	/* slots past the end of the table continue into the table being rehashed */
+	for (;; itr->slot++) {
+		table = itr->map;
+		slot = itr->slot;
+		if (slot >= table->capacity) {
+			slot -= table->capacity;
+			table = table->rehashing;
+		}
+		if (SLOT_OCCUPIED(table, slot)) break;
 	}
 	itr->index++;
-	return entry;
+	itr->slot++;
+	return &table->table[slot];
 }
@@ -0,0 +1,169 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DS_NAME "hashset"
+#include "err/ds_assert.h"
+#include "ds_allocator.h"
+#include "hashset.h"
+
+#define INITIAL_CAPACITY 16
+
+#define HASH_OF(this, key) ((size_t)(unsigned)(this)->hash(key))
+
+struct hashset_ds {
+	int (*hash)(const void*);
+	int (*is_equals)(const void*, const void*);
+	size_t size;
+	size_t capacity;
+	size_t load_factor;
+	void **table;			/* keys stored inline, nothing else */
+	unsigned char *meta;	/* probe sequence lengths, one byte per slot */
+	ds_allocator allocator;
+};
+
+/* same robin-hood table as the hashmap's, slots without a cached hash hash their key again on long chains */
+#define RH_TABLE hashset_ds
+#define RH_SLOT void*
+#define RH_KEY(slot) (slot)
+#define RH_SLOT_HASH(this, i) HASH_OF(this, (this)->table[i])
+#define RH_MATCHES(this, i, key, hash) (this)->is_equals((this)->table[i], key)
+#include "impl/robinhood.h"
+
+static void hashset_alloc_table(hashset_ds *const this, size_t capacity) {
+	this->size = 0;
+	this->capacity = capacity;
+	this->load_factor = (capacity * 3) >> 2;
+	this->table = ds_alloc(&this->allocator, capacity * sizeof *this->table);
+	DS_ASSERT(this->table != NULL, "failed to allocate memory for the " DS_NAME "'s table");
+	
+	this->meta = ds_alloc(&this->allocator, capacity * sizeof *this->meta);
+	DS_ASSERT(this->meta != NULL, "failed to allocate memory for the " DS_NAME "'s probe sequence lengths");
+	memset(this->meta, PSL_VACANT, capacity * sizeof *this->meta);
+}
+
+static void hashset_free_table(hashset_ds *const this) {
+	ds_free(&this->allocator, this->table, this->capacity * sizeof *this->table);
+	ds_free(&this->allocator, this->meta, this->capacity * sizeof *this->meta);
+}
+
+hashset_ds *alloc_hashset(int hash(const void*), int is_equals(const void*, const void*)) {
+	return alloc_hashset_with(hash, is_equals, NULL);
+}
+
+hashset_ds *alloc_hashset_with(int hash(const void*), int is_equals(const void*, const void*), const ds_allocator *allocator) {
+	hashset_ds *this;
+	if (allocator == NULL) allocator = &ds_default_allocator;
+	
+	this = ds_alloc(allocator, sizeof *this);
+	DS_ASSERT(this != NULL, "failed to allocate memory for new " DS_NAME);
+	
+	this->allocator = *allocator;
+	this->hash = hash;
+	this->is_equals = is_equals;
+	hashset_alloc_table(this, INITIAL_CAPACITY);
+	return this;
+}
+
+void dealloc_hashset(hashset_ds *const this) {
+	hashset_free_table(this);
+	ds_free(&this->allocator, this, sizeof *this);
+}
+
+static void hashset_rehash(hashset_ds *const this) {
+	size_t i;
+	hashset_ds temp = *this;
+	hashset_alloc_table(&temp, this->capacity << 1);
+	
+	/* put all keys from the hashset's old table */
+	for (i = 0; i < this->capacity; i++) {
+		if (this->meta[i] != PSL_VACANT) {
+			robinhood_insert(&temp, this->table[i], HASH_OF(this, this->table[i]), 1);
+		}
+	}
+	
+	hashset_free_table(this);
+	*this = temp;
+}
+
+int hashset_add(hashset_ds *const this, void *key) {
+	if (robinhood_insert(this, key, HASH_OF(this, key), 0) != this->capacity) return 0;
+	if (this->size >= this->load_factor) hashset_rehash(this);
+	return 1;
+}
+
+int hashset_contains(hashset_ds *const this, const void *key) {
+	return robinhood_search(this, key, HASH_OF(this, key)) != this->capacity;
+}
+
+void *hashset_remove(hashset_ds *const this, const void *key) {
+	void *oldkey = NULL;
+	size_t i = robinhood_search(this, key, HASH_OF(this, key));
+	if (i != this->capacity) {
+		oldkey = this->table[i];
+		robinhood_erase(this, i);
+		this->size--;
+	}
+	return oldkey;
+}
+
+size_t hashset_size(hashset_ds *const this) {
+	return this->size;
+}
+
+void hashset_union(hashset_ds *const this, hashset_ds *const other) {
+	size_t i;
+	for (i = 0; i < other->capacity; i++) {
+		if (other->meta[i] != PSL_VACANT) hashset_add(this, other->table[i]);
+	}
+}
+
+typedef struct hashset_membership {
+	hashset_ds *other;
+	int member;
+} hashset_membership;
+
+static int hashset_membership_doomed(hashset_ds *const this, size_t i, void *context) {
+	hashset_membership *membership = context;
+	return !hashset_contains(membership->other, this->table[i]) == !membership->member;
+}
+
+/* removes the keys whose membership in other is the given one, in a single pass over the table */
+static void hashset_remove_if(hashset_ds *const this, hashset_ds *const other, int member) {
+	hashset_membership membership;
+	
+	/* keys are looked up in other while the pass moves them around, so a hashset can't be its own other */
+	if (this == other) {
+		if (member) {
+			memset(this->meta, PSL_VACANT, this->capacity * sizeof *this->meta);
+			this->size = 0;
+		}
+		return;
+	}
+	
+	membership.other = other;
+	membership.member = member;
+	this->size -= robinhood_compact(this, hashset_membership_doomed, &membership);
+}
+
+void hashset_intersection(hashset_ds *const this, hashset_ds *const other) {
+	hashset_remove_if(this, other, 0);
+}
+
+void hashset_difference(hashset_ds *const this, hashset_ds *const other) {
+	hashset_remove_if(this, other, 1);
+}
+
+void **hashset_getkeys(hashset_ds *const this) {
+	size_t i, j = 0;
+	
+	/* allocate a list of keys + one more slot that indicates the end of a list using NULL */
+	void **keys = malloc((this->size + 1) * sizeof *keys);
+	DS_ASSERT(keys != NULL, "failed to allocate a list of keys");
+	
+	for (i = 0; i < this->capacity; i++) {
+		if (this->meta[i] != PSL_VACANT) keys[j++] = this->table[i];
+	}
+	keys[j] = NULL;
+	return keys;
+}
@@ -0,0 +1,157 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sched.h>
+
+#define DS_NAME "mpmcqueue"
+#include "err/ds_assert.h"
+#include "ds_allocator.h"
+#include "mpmcqueue.h"
+
+#define CACHE_LINE 64
+
+#define LOAD(ptr) __atomic_load_n(ptr, __ATOMIC_RELAXED)
+#define LOAD_ACQUIRE(ptr) __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+#define STORE_RELEASE(ptr, val) __atomic_store_n(ptr, val, __ATOMIC_RELEASE)
+/* the slots' sequences order the elements themselves, so claiming a position needs no ordering of its own */
+#define CLAIM(ptr, expected, desired) __atomic_compare_exchange_n(ptr, expected, desired, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED)
+
+/*
+ * A slot at position p (before masking) may be filled once its sequence is p, and emptied once it's p + 1.
+ * Emptying it sets it to p + capacity, which is where the next lap of the ring may fill it again.
+ */
+typedef struct mpmcqueue_slot {
+	size_t sequence;
+	void *el;
+} mpmcqueue_slot;
+
+struct mpmcqueue_ds {
+	/* producers only touch the tail and consumers only the head, so both are kept to cache lines of their own */
+	union mpmcqueue_padded_index {
+		size_t index;
+		char padding[CACHE_LINE];
+	} tail, head;
+	size_t capacity;
+	mpmcqueue_slot *ring;
+	ds_allocator allocator;
+};
+
+mpmcqueue_ds *alloc_mpmcqueue(size_t capacity) {
+	return alloc_mpmcqueue_with(capacity, NULL);
+}
+
+mpmcqueue_ds *alloc_mpmcqueue_with(size_t capacity, const ds_allocator *allocator) {
+	mpmcqueue_ds *this;
+	size_t i, rounded = 2;
+	if (allocator == NULL) allocator = &ds_default_allocator;
+	
+	while (rounded < capacity) {
+		rounded <<= 1;
+	}
+	
+	this = ds_alloc(allocator, sizeof *this);
+	DS_ASSERT(this != NULL, "failed to allocate memory for new " DS_NAME);
+	
+	this->allocator = *allocator;
+	this->tail.index = 0;
+	this->head.index = 0;
+	this->capacity = rounded;
+	this->ring = ds_alloc(allocator, rounded * sizeof *this->ring);
+	DS_ASSERT(this->ring != NULL, "failed to allocate memory for the " DS_NAME "'s ring");
+	
+	for (i = 0; i < rounded; i++) {
+		this->ring[i].sequence = i;
+	}
+	return this;
+}
+
+void dealloc_mpmcqueue(mpmcqueue_ds *const this) {
+	ds_free(&this->allocator, this->ring, this->capacity * sizeof *this->ring);
+	ds_free(&this->allocator, this, sizeof *this);
+}
+
+/*
+ * Claims up to n consecutive positions of a side, those whose slots' sequences are already their position
+ * plus lag (0 for producers, 1 for consumers). Returns how many were claimed, storing the first one to
+ * position, or 0 if the slot at the side's index isn't ready yet, i.e. the queue is full or empty.
+ */
+static size_t mpmcqueue_claim(mpmcqueue_ds *const this, size_t *index, size_t lag, size_t n, size_t *position) {
+	size_t mask = this->capacity - 1;
+	size_t first = LOAD(index);
+	if (n > this->capacity) n = this->capacity;
+	
+	for (;;) {
+		size_t sequence = 0, ready = 0;
+		
+		while (ready < n) {
+			sequence = LOAD_ACQUIRE(&this->ring[(first + ready) & mask].sequence);
+			if (sequence != first + ready + lag) break;
+			ready++;
+		}
+		
+		if (ready == 0) {
+			/* a sequence behind the index is a slot the other side hasn't handed over yet */
+			if ((ptrdiff_t)(sequence - (first + lag)) < 0) return 0;
+			/* one ahead of it means other threads claimed it meanwhile */
+			first = LOAD(index);
+		} else if (CLAIM(index, &first, first + ready)) {
+			*position = first;
+			return ready;
+		}
+	}
+}
+
+int mpmcqueue_try_push(mpmcqueue_ds *const this, void *el) {
+	return mpmcqueue_push_n(this, &el, 1) != 0;
+}
+
+void mpmcqueue_push(mpmcqueue_ds *const this, void *el) {
+	while (!mpmcqueue_try_push(this, el)) {
+		sched_yield();
+	}
+}
+
+size_t mpmcqueue_push_n(mpmcqueue_ds *const this, void *const *els, size_t n) {
+	size_t i, position;
+	n = mpmcqueue_claim(this, &this->tail.index, 0, n, &position);
+	
+	for (i = 0; i < n; i++) {
+		mpmcqueue_slot *slot = &this->ring[(position + i) & (this->capacity - 1)];
+		slot->el = els[i];
+		STORE_RELEASE(&slot->sequence, position + i + 1);
+	}
+	return n;
+}
+
+void *mpmcqueue_try_pop(mpmcqueue_ds *const this) {
+	void *el;
+	return mpmcqueue_pop_n(this, &el, 1) != 0 ? el : NULL;
+}
+
+void *mpmcqueue_pop(mpmcqueue_ds *const this) {
+	void *el;
+	while ((el = mpmcqueue_try_pop(this)) == NULL) {
+		sched_yield();
+	}
+	return el;
+}
+
+size_t mpmcqueue_pop_n(mpmcqueue_ds *const this, void **out, size_t n) {
+	size_t i, position;
+	n = mpmcqueue_claim(this, &this->head.index, 1, n, &position);
+	
+	for (i = 0; i < n; i++) {
+		mpmcqueue_slot *slot = &this->ring[(position + i) & (this->capacity - 1)];
+		out[i] = slot->el;
+		STORE_RELEASE(&slot->sequence, position + i + this->capacity);
+	}
+	return n;
+}
+
+size_t mpmcqueue_size(mpmcqueue_ds *const this) {
+	size_t head = LOAD(&this->head.index);
+	size_t size = LOAD(&this->tail.index) - head;
+	
+	/* the indices aren't read at once, so the difference may be off by the operations that happened in between */
+	if ((ptrdiff_t)size < 0) return 0;
+	return size < this->capacity ? size : this->capacity;
+}
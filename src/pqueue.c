@@ -4,85 +4,154 @@
 
 #define DS_NAME "pqueue"
 #include "err/ds_assert.h"
+#include "ds_allocator.h"
 #include "pqueue.h"
 
+#define INITIAL_CAPACITY 16
+
+/* position of elements that aren't in the heap */
+#define NO_POSITION ((size_t)-1)
+#define HANDLE(this, element) (*(size_t*)((char*)(element) + (this)->handle_offset))
+
 struct pqueue_ds {
 	int (*compare)(const void*, const void*);
 	size_t size;
 	size_t capacity;
-	hashmap_ds *indexmap;
+	size_t reserved;	/* capacity the heap doesn't shrink below by itself */
+	size_t handle_offset;	/* offset of the elements' handles, only used without an index */
+	hashmap_ds *indexmap;	/* NULL for intrusive pqueues */
 	void **heap;
+	ds_allocator allocator;
 };
 
-pqueue_ds *alloc_pqueue(int comparator(const void*,const void*)) {
-	pqueue_ds *this = malloc(sizeof *this);
+static pqueue_ds *alloc_pqueue_internal(int comparator(const void*,const void*), size_t handle_offset, int indexed, const ds_allocator *allocator) {
+	pqueue_ds *this;
+	if (allocator == NULL) allocator = &ds_default_allocator;
+	
+	this = ds_alloc(allocator, sizeof *this);
 	DS_ASSERT(this != NULL, "failed to allocate memory for new " DS_NAME);
 	
+	this->allocator = *allocator;
 	this->size = 0;
-	this->capacity = 16;
+	this->capacity = INITIAL_CAPACITY;
+	this->reserved = 0;
+	this->handle_offset = handle_offset;
 	this->compare = comparator;
-	this->heap = malloc(16 * sizeof *this->heap);
+	this->heap = ds_alloc(allocator, INITIAL_CAPACITY * sizeof *this->heap);
 	DS_ASSERT(this->heap != NULL, "failed to allocate the heap");
 	
-	this->indexmap = alloc_identityhashmap();
+	this->indexmap = indexed ? alloc_identityhashmap_with(allocator) : NULL;
 	return this;
 }
 
+pqueue_ds *alloc_pqueue(int comparator(const void*,const void*)) {
+	return alloc_pqueue_with(comparator, NULL);
+}
+
+pqueue_ds *alloc_pqueue_with(int comparator(const void*,const void*), const ds_allocator *allocator) {
+	return alloc_pqueue_internal(comparator, 0, 1, allocator);
+}
+
+pqueue_ds *alloc_pqueue_intrusive(int comparator(const void*,const void*), size_t handle_offset) {
+	return alloc_pqueue_intrusive_with(comparator, handle_offset, NULL);
+}
+
+pqueue_ds *alloc_pqueue_intrusive_with(int comparator(const void*,const void*), size_t handle_offset, const ds_allocator *allocator) {
+	return alloc_pqueue_internal(comparator, handle_offset, 0, allocator);
+}
+
 void dealloc_pqueue(pqueue_ds *const this) {
 	size_t i;
 	hashmap_entry **index_mappings;
 	
-	free(this->heap);
+	ds_free(&this->allocator, this->heap, this->capacity * sizeof *this->heap);
 	
-	index_mappings = hashmap_getentries(this->indexmap);
-	for (i = 0; index_mappings[i] != NULL; i++) {
-		free(index_mappings[i]->value);
+	if (this->indexmap != NULL) {
+		index_mappings = hashmap_getentries(this->indexmap);
+		for (i = 0; index_mappings[i] != NULL; i++) {
+			ds_free(&this->allocator, index_mappings[i]->value, sizeof(size_t));
+		}
+		free(index_mappings);
+		dealloc_hashmap(this->indexmap);
 	}
-	free(index_mappings);
-	dealloc_hashmap(this->indexmap);
 	
-	free(this);
+	ds_free(&this->allocator, this, sizeof *this);
+}
+
+static void pqueue_resize(pqueue_ds *const this, size_t capacity) {
+	this->heap = ds_realloc(&this->allocator, this->heap, this->capacity * sizeof *this->heap, capacity * sizeof *this->heap);
+	DS_ASSERT(this->heap != NULL, "failed to resize the heap");
+	this->capacity = capacity;
+}
+
+/* halves the heap once it's only a quarter full, so that shrinking it again takes as long as growing it back */
+static void pqueue_trim(pqueue_ds *const this) {
+	size_t half = this->capacity >> 1;
+	if (this->size <= this->capacity >> 2 && half >= INITIAL_CAPACITY && half >= this->reserved) pqueue_resize(this, half);
+}
+
+/* retrieves the position of the element in the heap, or NO_POSITION if it isn't in it */
+static size_t pqueue_position(pqueue_ds *const this, void *element) {
+	size_t *index;
+	if (this->indexmap == NULL) {
+		/* a handle only counts if the heap agrees with it, so it may hold anything while the element isn't enqueued */
+		size_t handle = HANDLE(this, element);
+		return handle < this->size && this->heap[handle] == element ? handle : NO_POSITION;
+	}
+	index = hashmap_get(this->indexmap, element);
+	return index != NULL ? *index : NO_POSITION;
 }
 
+/* stores the element at the given position of the heap and records that position in its handle or the index */
+static void pqueue_place(pqueue_ds *const this, size_t position, void *element) {
+	this->heap[position] = element;
+	if (this->indexmap == NULL) {
+		HANDLE(this, element) = position;
+	} else {
+		*(size_t*)hashmap_get(this->indexmap, element) = position;
+	}
+}
+
+/*
+ * Both directions carry the element along and only move the elements it passes, placing the element itself
+ * once where it stops, so that every level costs a single position update instead of swapping two.
+ */
 static void reheapify_up(pqueue_ds *const this, size_t initial) {
-	void *temp;
-	size_t parent = (initial - 1) / 4;
-	while (initial != 0 && this->compare(this->heap[initial], this->heap[parent]) < 0) {
-		*(size_t*)hashmap_get(this->indexmap, this->heap[initial]) = parent;
-		*(size_t*)hashmap_get(this->indexmap, this->heap[parent]) = initial;
-		
-		temp = this->heap[parent];
-		this->heap[parent] = this->heap[initial];
-		this->heap[initial] = temp;
+	void *element = this->heap[initial];
+	while (initial != 0) {
+		size_t parent = (initial - 1) / 4;
+		if (this->compare(element, this->heap[parent]) >= 0) break;
 		
+		pqueue_place(this, initial, this->heap[parent]);
 		initial = parent;
-		parent = (parent - 1) / 4;
 	}
+	pqueue_place(this, initial, element);
 }
 
 static void reheapify_down(pqueue_ds *const this, size_t initial) {
-	void *temp;
-	size_t i, child, smallest = initial;
-	while(initial < this->size) {
-		/* go through all children of the parent (initial) to determine if there's a smallest child */
-		for (i = 1; i <= 4; i++) {
-			child = (4 * initial) + i;
-			if (child < this->size && this->compare(this->heap[child], this->heap[smallest]) < 0) {
-				smallest = child;
+	void *element = this->heap[initial];
+	size_t i, child, smallest;
+	while ((child = (4 * initial) + 1) < this->size) {
+		/* go through all children of the parent (initial) to determine the smallest one */
+		for (smallest = child, i = child + 1; i < child + 4 && i < this->size; i++) {
+			if (this->compare(this->heap[i], this->heap[smallest]) < 0) {
+				smallest = i;
 			}
 		}
+		if (this->compare(this->heap[smallest], element) >= 0) break;
+		
+		pqueue_place(this, initial, this->heap[smallest]);
+		initial = smallest;
+	}
+	pqueue_place(this, initial, element);
+}
 
-		if (smallest != initial) {
-			*(size_t*)hashmap_get(this->indexmap, this->heap[initial]) = smallest;
-			*(size_t*)hashmap_get(this->indexmap, this->heap[smallest]) = initial;
-			
-			temp = this->heap[initial];
-			this->heap[initial] = this->heap[smallest];
-			this->heap[smallest] = temp;
-			initial = smallest;
-		} else {
-			break;
-		}
+/* restores the heap after the element at the given position may have moved in either direction */
+static void reheapify(pqueue_ds *const this, size_t index) {
+	if (index > 0 && this->compare(this->heap[index], this->heap[(index - 1) / 4]) < 0) {
+		reheapify_up(this, index);
+	} else {
+		reheapify_down(this, index);
 	}
 }
 
@@ -90,22 +159,18 @@ int pqueue_enqueue(pqueue_ds *const this, void *element) {
 	size_t *newindex;
 	
 	/* element already exists in priority queue */
-	if (hashmap_get(this->indexmap, element) != NULL) return 0;
+	if (pqueue_position(this, element) != NO_POSITION) return 0;
 	
-	if (this->size >= this->capacity) {
-		size_t new_capacity = this->capacity << 1;
-		this->heap = realloc(this->heap, new_capacity * sizeof *this->heap);
-		DS_ASSERT(this->heap != NULL, "failed to expand the heap");
-
-		this->capacity = new_capacity;
-	}
-	this->heap[this->size++] = element;
+	if (this->size >= this->capacity) pqueue_resize(this, this->capacity << 1);
 	
-	newindex = malloc(sizeof *newindex);
-	*newindex = this->size-1;
-	hashmap_put(this->indexmap, element, newindex);
+	if (this->indexmap != NULL) {
+		newindex = ds_alloc(&this->allocator, sizeof *newindex);
+		DS_ASSERT(newindex != NULL, "failed to allocate memory for the element's index");
+		hashmap_put(this->indexmap, element, newindex);
+	}
 	
-	reheapify_up(this, *newindex);
+	this->heap[this->size] = element;
+	reheapify_up(this, this->size++);
 	return 1;
 }
 
@@ -114,54 +179,67 @@ void *pqueue_dequeue(pqueue_ds *const this) {
 	void *oldval = NULL;
 	if (this->size != 0) {
 		oldval = this->heap[0];
-		free(hashmap_remove(this->indexmap, oldval));
-		
-		if (this->size == 1) {
-			this->heap[0] = NULL;
-			this->size--;
-			return oldval;
-		}
+		if (this->indexmap != NULL) ds_free(&this->allocator, hashmap_remove(this->indexmap, oldval), sizeof(size_t));
 		
+		/* the last element takes the head's place and sinks from there */
 		this->heap[0] = this->heap[--this->size];
-		*(size_t*)hashmap_get(this->indexmap, this->heap[0]) = 0;
 		this->heap[this->size] = NULL;
-		reheapify_down(this, 0);
+		if (this->size != 0) reheapify_down(this, 0);
+		pqueue_trim(this);
 	}
 	return oldval;
 }
 
 void pqueue_update(pqueue_ds *const this, void *element) {
-	size_t index = *(size_t*)hashmap_get(this->indexmap, element);
-	size_t parent = (index - 1) / 4;
-	if (index > 0 && this->compare(this->heap[index], this->heap[parent]) < 0) {
-		reheapify_up(this, index);
-	} else {
-		reheapify_down(this, index);
-	}
+	size_t index = pqueue_position(this, element);
+	if (index != NO_POSITION) reheapify(this, index);
 }
 
 void *pqueue_remove(pqueue_ds *const this, void *element) {
+	size_t last, index = pqueue_position(this, element);
+	if (index == NO_POSITION) return NULL;
+	
 	/* remove element-index mapping from the hashmap first */
-	size_t last, index = *(size_t*)hashmap_get(this->indexmap, element);
-	free(hashmap_remove(this->indexmap, element));
+	if (this->indexmap != NULL) ds_free(&this->allocator, hashmap_remove(this->indexmap, element), sizeof(size_t));
 	
-	/* swap with the last item in the heap, and update its element-index mapping */
 	last = --this->size;
 	
-	/* if the item we're removing isn't the last item in the heap, then a swap and reheapification is needed */
+	/* if the item we're removing isn't the last item in the heap, then the last one takes its place */
 	if (index != last) {
 		this->heap[index] = this->heap[last];
-		this->heap[this->size] = NULL;
-		*(size_t*)hashmap_get(this->indexmap, this->heap[index]) = index;
-	
-		/* call pqueue_update */
-		pqueue_update(this, this->heap[index]);
+		this->heap[last] = NULL;
+		reheapify(this, index);
 	} else {
 		this->heap[last] = NULL;
 	}
+	pqueue_trim(this);
 	return element;
 }
 
 void *pqueue_peek(pqueue_ds *const this) {
 	return this->size != 0 ? this->heap[0] : NULL;
 }
+
+void pqueue_reserve(pqueue_ds *const this, size_t capacity) {
+	this->reserved = capacity;
+	if (capacity > this->capacity) pqueue_resize(this, capacity);
+}
+
+void pqueue_shrink_to_fit(pqueue_ds *const this) {
+	hashmap_ds *indexmap;
+	size_t i;
+	
+	this->reserved = 0;
+	if (this->capacity != this->size && this->capacity > INITIAL_CAPACITY) {
+		pqueue_resize(this, this->size > INITIAL_CAPACITY ? this->size : INITIAL_CAPACITY);
+	}
+	
+	/* hashmaps never shrink, so the index is moved over to a fresh one sized for the current elements */
+	if (this->indexmap == NULL) return;
+	indexmap = alloc_identityhashmap_with(&this->allocator);
+	for (i = 0; i < this->size; i++) {
+		hashmap_put(indexmap, this->heap[i], hashmap_get(this->indexmap, this->heap[i]));
+	}
+	dealloc_hashmap(this->indexmap);
+	this->indexmap = indexmap;
+}
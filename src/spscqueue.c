@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DS_NAME "spscqueue"
+#include "err/ds_assert.h"
+#include "ds_allocator.h"
+#include "spscqueue.h"
+
+#define CACHE_LINE 64
+
+#define LOAD_ACQUIRE(ptr) __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+#define STORE_RELEASE(ptr, val) __atomic_store_n(ptr, val, __ATOMIC_RELEASE)
+
+/*
+ * Indices run freely and are only masked to address the ring, so the queue is full whenever the tail is
+ * a whole capacity ahead of the head. Each side writes nothing but its own fields.
+ */
+typedef struct spscqueue_side {
+	size_t index;		/* head of the consumer, tail of the producer */
+	size_t cached;		/* other side's index as last read, it only ever moves out of the way */
+} spscqueue_side;
+
+struct spscqueue_ds {
+	/* both sides are padded to their own cache lines, away from each other and from the fields both read */
+	union spscqueue_padded_side {
+		spscqueue_side side;
+		char padding[((sizeof(spscqueue_side) + CACHE_LINE - 1) / CACHE_LINE) * CACHE_LINE];
+	} producer, consumer;
+	size_t capacity;
+	void **ring;
+	ds_allocator allocator;
+};
+
+spscqueue_ds *alloc_spscqueue(size_t capacity) {
+	return alloc_spscqueue_with(capacity, NULL);
+}
+
+spscqueue_ds *alloc_spscqueue_with(size_t capacity, const ds_allocator *allocator) {
+	spscqueue_ds *this;
+	size_t rounded = 2;
+	if (allocator == NULL) allocator = &ds_default_allocator;
+	
+	while (rounded < capacity) {
+		rounded <<= 1;
+	}
+	
+	this = ds_alloc(allocator, sizeof *this);
+	DS_ASSERT(this != NULL, "failed to allocate memory for new " DS_NAME);
+	
+	this->allocator = *allocator;
+	this->producer.side.index = 0;
+	this->producer.side.cached = 0;
+	this->consumer.side.index = 0;
+	this->consumer.side.cached = 0;
+	this->capacity = rounded;
+	this->ring = ds_alloc(allocator, rounded * sizeof *this->ring);
+	DS_ASSERT(this->ring != NULL, "failed to allocate memory for the " DS_NAME "'s ring");
+	return this;
+}
+
+void dealloc_spscqueue(spscqueue_ds *const this) {
+	ds_free(&this->allocator, this->ring, this->capacity * sizeof *this->ring);
+	ds_free(&this->allocator, this, sizeof *this);
+}
+
+/* slots the producer may fill, rereading the consumer's head only if the cached one leaves fewer than wanted */
+static size_t spscqueue_room(spscqueue_ds *const this, size_t wanted) {
+	spscqueue_side *producer = &this->producer.side;
+	size_t room = this->capacity - (producer->index - producer->cached);
+	if (room < wanted) {
+		producer->cached = LOAD_ACQUIRE(&this->consumer.side.index);
+		room = this->capacity - (producer->index - producer->cached);
+	}
+	return room;
+}
+
+/* elements the consumer may take, rereading the producer's tail only if the cached one leaves fewer than wanted */
+static size_t spscqueue_available(spscqueue_ds *const this, size_t wanted) {
+	spscqueue_side *consumer = &this->consumer.side;
+	size_t available = consumer->cached - consumer->index;
+	if (available < wanted) {
+		consumer->cached = LOAD_ACQUIRE(&this->producer.side.index);
+		available = consumer->cached - consumer->index;
+	}
+	return available;
+}
+
+int spscqueue_push(spscqueue_ds *const this, void *el) {
+	size_t tail = this->producer.side.index;
+	if (spscqueue_room(this, 1) == 0) return 0;
+	
+	this->ring[tail & (this->capacity - 1)] = el;
+	STORE_RELEASE(&this->producer.side.index, tail + 1);
+	return 1;
+}
+
+void *spscqueue_pop(spscqueue_ds *const this) {
+	void *el;
+	size_t head = this->consumer.side.index;
+	if (spscqueue_available(this, 1) == 0) return NULL;
+	
+	el = this->ring[head & (this->capacity - 1)];
+	STORE_RELEASE(&this->consumer.side.index, head + 1);
+	return el;
+}
+
+size_t spscqueue_push_n(spscqueue_ds *const this, void *const *els, size_t n) {
+	size_t first, slot, tail = this->producer.side.index;
+	size_t room = spscqueue_room(this, n);
+	if (n > room) n = room;
+	
+	/* the ring's wraparound splits the copy in two at most */
+	slot = tail & (this->capacity - 1);
+	first = n < this->capacity - slot ? n : this->capacity - slot;
+	memcpy(this->ring + slot, els, first * sizeof *els);
+	memcpy(this->ring, els + first, (n - first) * sizeof *els);
+	STORE_RELEASE(&this->producer.side.index, tail + n);
+	return n;
+}
+
+size_t spscqueue_pop_n(spscqueue_ds *const this, void **out, size_t n) {
+	size_t first, slot, head = this->consumer.side.index;
+	size_t available = spscqueue_available(this, n);
+	if (n > available) n = available;
+	
+	slot = head & (this->capacity - 1);
+	first = n < this->capacity - slot ? n : this->capacity - slot;
+	memcpy(out, this->ring + slot, first * sizeof *out);
+	memcpy(out + first, this->ring, (n - first) * sizeof *out);
+	STORE_RELEASE(&this->consumer.side.index, head + n);
+	return n;
+}
+
+size_t spscqueue_size(spscqueue_ds *const this) {
+	size_t head = LOAD_ACQUIRE(&this->consumer.side.index);
+	size_t tail = LOAD_ACQUIRE(&this->producer.side.index);
+	
+	/* the head is read first, so the tail can't have fallen behind it */
+	return tail - head;
+}
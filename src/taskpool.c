@@ -0,0 +1,294 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+#include "deque.h"
+#include "wsdeque.h"
+
+#define DS_NAME "taskpool"
+#include "err/ds_assert.h"
+#include "ds_allocator.h"
+#include "taskpool.h"
+
+#define CACHE_LINE 64
+/* passes over every deque an idle worker makes while tasks are pending, before it goes to sleep */
+#define IDLE_PASSES 64
+
+#define LOAD(ptr) __atomic_load_n(ptr, __ATOMIC_RELAXED)
+#define LOAD_ACQUIRE(ptr) __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+
+typedef struct taskpool_task {
+	void (*run)(taskpool_ds*, void*);
+	void *arg;
+	struct taskpool_task *next;	/* link of the free list of the worker that ran the task last */
+} taskpool_task;
+
+typedef struct taskpool_thread {
+	taskpool_ds *pool;
+	wsdeque_ds *tasks;
+	taskpool_task *free;	/* finished tasks kept for reuse, only the worker itself touches them */
+	unsigned seed;
+	int index;
+	pthread_t thread;
+} taskpool_thread;
+
+struct taskpool_ds {
+	size_t pending;		/* spawned tasks that haven't finished yet */
+	size_t injected_count;	/* tasks in the injected queue, read without the lock to skip it when empty */
+	size_t sleeping;	/* workers that are about to wait for work or waiting for it */
+	size_t wakeups;		/* bumped under the lock whenever sleeping workers should look for tasks again */
+	int threads;
+	int stop;
+	/* each worker is padded to its own cache lines, since they're written to by their workers only */
+	union taskpool_padded_thread {
+		taskpool_thread worker;
+		char padding[((sizeof(taskpool_thread) + CACHE_LINE - 1) / CACHE_LINE) * CACHE_LINE];
+	} *workers;
+	deque_ds *injected;	/* tasks spawned from outside the pool */
+	pthread_key_t current;	/* worker of the calling thread */
+	pthread_mutex_t lock;	/* guards the injected queue, stop and wakeups */
+	pthread_cond_t work;	/* signaled once there are tasks again */
+	pthread_cond_t done;	/* signaled once there are no tasks anymore */
+	ds_allocator allocator;
+};
+
+static void *taskpool_work(void *arg);
+
+static void taskpool_wake(taskpool_ds *const this) {
+	pthread_mutex_lock(&this->lock);
+	this->wakeups++;
+	pthread_cond_broadcast(&this->work);
+	pthread_mutex_unlock(&this->lock);
+}
+
+taskpool_ds *alloc_taskpool(int threads) {
+	return alloc_taskpool_with(threads, NULL);
+}
+
+taskpool_ds *alloc_taskpool_with(int threads, const ds_allocator *allocator) {
+	taskpool_ds *this;
+	int i;
+	if (allocator == NULL) allocator = &ds_default_allocator;
+	if (threads < 1) threads = 1;
+	
+	this = ds_alloc(allocator, sizeof *this);
+	DS_ASSERT(this != NULL, "failed to allocate memory for new " DS_NAME);
+	
+	this->allocator = *allocator;
+	this->pending = 0;
+	this->injected_count = 0;
+	this->sleeping = 0;
+	this->wakeups = 0;
+	this->threads = threads;
+	this->stop = 0;
+	this->workers = ds_alloc(allocator, threads * sizeof *this->workers);
+	DS_ASSERT(this->workers != NULL, "failed to allocate memory for the " DS_NAME "'s workers");
+	this->injected = alloc_deque_with(DEQUE_RING, allocator);
+	DS_ASSERT(pthread_key_create(&this->current, NULL) == 0, "failed to create the " DS_NAME "'s thread key");
+	DS_ASSERT(pthread_mutex_init(&this->lock, NULL) == 0, "failed to initialize the " DS_NAME "'s lock");
+	DS_ASSERT(pthread_cond_init(&this->work, NULL) == 0, "failed to initialize the " DS_NAME "'s condition");
+	DS_ASSERT(pthread_cond_init(&this->done, NULL) == 0, "failed to initialize the " DS_NAME "'s condition");
+	
+	for (i = 0; i < threads; i++) {
+		taskpool_thread *worker = &this->workers[i].worker;
+		worker->pool = this;
+		worker->tasks = alloc_wsdeque_with(allocator);
+		worker->free = NULL;
+		worker->seed = 2463534242u + i;
+		worker->index = i;
+	}
+	/* only start the workers once all of their deques exist, they steal from each other right away */
+	for (i = 0; i < threads; i++) {
+		taskpool_thread *worker = &this->workers[i].worker;
+		DS_ASSERT(pthread_create(&worker->thread, NULL, taskpool_work, worker) == 0, "failed to start a " DS_NAME "'s worker");
+	}
+	return this;
+}
+
+void dealloc_taskpool(taskpool_ds *const this) {
+	int i;
+	taskpool_wait(this);
+	
+	pthread_mutex_lock(&this->lock);
+	this->stop = 1;
+	this->wakeups++;
+	pthread_cond_broadcast(&this->work);
+	pthread_mutex_unlock(&this->lock);
+	
+	/* workers may still steal from each other until they've all stopped */
+	for (i = 0; i < this->threads; i++) {
+		pthread_join(this->workers[i].worker.thread, NULL);
+	}
+	for (i = 0; i < this->threads; i++) {
+		taskpool_thread *worker = &this->workers[i].worker;
+		while (worker->free != NULL) {
+			taskpool_task *next = worker->free->next;
+			ds_free(&this->allocator, worker->free, sizeof *worker->free);
+			worker->free = next;
+		}
+		dealloc_wsdeque(worker->tasks);
+	}
+	
+	pthread_cond_destroy(&this->done);
+	pthread_cond_destroy(&this->work);
+	pthread_mutex_destroy(&this->lock);
+	pthread_key_delete(this->current);
+	dealloc_deque(this->injected);
+	ds_free(&this->allocator, this->workers, this->threads * sizeof *this->workers);
+	ds_free(&this->allocator, this, sizeof *this);
+}
+
+void taskpool_spawn(taskpool_ds *const this, void run(taskpool_ds*, void*), void *arg) {
+	taskpool_thread *worker = pthread_getspecific(this->current);
+	taskpool_task *task;
+	
+	if (worker != NULL && worker->free != NULL) {
+		task = worker->free;
+		worker->free = task->next;
+	} else {
+		task = ds_alloc(&this->allocator, sizeof *task);
+		DS_ASSERT(task != NULL, "failed to allocate memory for a " DS_NAME "'s task");
+	}
+	task->run = run;
+	task->arg = arg;
+	
+	if (worker != NULL) {
+		__atomic_add_fetch(&this->pending, 1, __ATOMIC_RELAXED);
+		wsdeque_push(worker->tasks, task);
+		
+		/* either a worker going to sleep finds the task when it looks one last time, or it's seen sleeping here */
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		if (LOAD(&this->sleeping) != 0) taskpool_wake(this);
+		return;
+	}
+	
+	pthread_mutex_lock(&this->lock);
+	deque_enqueue(this->injected, task);
+	__atomic_add_fetch(&this->injected_count, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&this->pending, 1, __ATOMIC_RELAXED);
+	this->wakeups++;
+	pthread_cond_broadcast(&this->work);
+	pthread_mutex_unlock(&this->lock);
+}
+
+void taskpool_wait(taskpool_ds *const this) {
+	pthread_mutex_lock(&this->lock);
+	while (LOAD_ACQUIRE(&this->pending) != 0) {
+		pthread_cond_wait(&this->done, &this->lock);
+	}
+	pthread_mutex_unlock(&this->lock);
+}
+
+int taskpool_worker(taskpool_ds *const this) {
+	taskpool_thread *worker = pthread_getspecific(this->current);
+	return worker != NULL ? worker->index : -1;
+}
+
+/* xorshift, so that workers don't serialize on rand()'s internal state */
+static unsigned taskpool_random(taskpool_thread *const worker) {
+	worker->seed ^= worker->seed << 13;
+	worker->seed ^= worker->seed >> 17;
+	worker->seed ^= worker->seed << 5;
+	return worker->seed;
+}
+
+/* looks for a task in the worker's own deque first, then in the injected queue, then in other workers' deques */
+static taskpool_task *taskpool_find(taskpool_thread *const worker) {
+	taskpool_ds *pool = worker->pool;
+	taskpool_task *task = wsdeque_pop(worker->tasks);
+	int i, victim;
+	if (task != NULL) return task;
+	
+	if (LOAD(&pool->injected_count) != 0) {
+		pthread_mutex_lock(&pool->lock);
+		task = deque_dequeue(pool->injected);
+		if (task != NULL) __atomic_sub_fetch(&pool->injected_count, 1, __ATOMIC_RELAXED);
+		pthread_mutex_unlock(&pool->lock);
+		if (task != NULL) return task;
+	}
+	
+	victim = (int)(taskpool_random(worker) % (unsigned)pool->threads);
+	for (i = 0; i < pool->threads; i++, victim = (victim + 1) % pool->threads) {
+		if (victim == worker->index) continue;
+		task = wsdeque_steal(pool->workers[victim].worker.tasks);
+		if (task != NULL) return task;
+	}
+	return NULL;
+}
+
+static void taskpool_run(taskpool_thread *const worker, taskpool_task *task) {
+	taskpool_ds *pool = worker->pool;
+	task->run(pool, task->arg);
+	task->next = worker->free;
+	worker->free = task;
+	
+	if (__atomic_sub_fetch(&pool->pending, 1, __ATOMIC_ACQ_REL) == 0) {
+		pthread_mutex_lock(&pool->lock);
+		pthread_cond_broadcast(&pool->done);
+		pthread_mutex_unlock(&pool->lock);
+	}
+}
+
+/*
+ * Waits until a task may have been spawned since the worker last looked, returning NULL then, or returns a
+ * task it found looking one last time after announcing that it's about to sleep. Also returns NULL to stop.
+ */
+static taskpool_task *taskpool_sleep(taskpool_thread *const worker) {
+	taskpool_ds *pool = worker->pool;
+	taskpool_task *task;
+	size_t wakeups;
+	
+	pthread_mutex_lock(&pool->lock);
+	wakeups = pool->wakeups;
+	pthread_mutex_unlock(&pool->lock);
+	
+	__atomic_add_fetch(&pool->sleeping, 1, __ATOMIC_SEQ_CST);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	task = taskpool_find(worker);
+	
+	if (task == NULL) {
+		pthread_mutex_lock(&pool->lock);
+		while (!pool->stop && pool->wakeups == wakeups) {
+			pthread_cond_wait(&pool->work, &pool->lock);
+		}
+		pthread_mutex_unlock(&pool->lock);
+	}
+	__atomic_sub_fetch(&pool->sleeping, 1, __ATOMIC_RELAXED);
+	return task;
+}
+
+static void *taskpool_work(void *arg) {
+	taskpool_thread *worker = arg;
+	taskpool_ds *pool = worker->pool;
+	int idle = 0;
+	pthread_setspecific(pool->current, worker);
+	
+	for (;;) {
+		taskpool_task *task = taskpool_find(worker);
+		if (task != NULL) {
+			taskpool_run(worker, task);
+			idle = 0;
+			continue;
+		}
+		
+		/* a task is still running somewhere and may spawn more soon, so keep looking for a while */
+		if (LOAD(&pool->pending) != 0 && ++idle < IDLE_PASSES) {
+			sched_yield();
+			continue;
+		}
+		idle = 0;
+		
+		task = taskpool_sleep(worker);
+		if (task != NULL) {
+			taskpool_run(worker, task);
+			continue;
+		}
+		
+		pthread_mutex_lock(&pool->lock);
+		if (pool->stop) {
+			pthread_mutex_unlock(&pool->lock);
+			return NULL;
+		}
+		pthread_mutex_unlock(&pool->lock);
+	}
+}
@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#define DS_NAME "wsdeque"
+#include "err/ds_assert.h"
+#include "ds_allocator.h"
+#include "wsdeque.h"
+
+#define INITIAL_CAPACITY 64
+#define CACHE_LINE 64
+
+#define LOAD(ptr) __atomic_load_n(ptr, __ATOMIC_RELAXED)
+#define STORE(ptr, val) __atomic_store_n(ptr, val, __ATOMIC_RELAXED)
+#define LOAD_ACQUIRE(ptr) __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+#define STORE_RELEASE(ptr, val) __atomic_store_n(ptr, val, __ATOMIC_RELEASE)
+/* the owner's pop and the thieves' steals must agree on which of them saw the other's index first */
+#define LOAD_SEQ(ptr) __atomic_load_n(ptr, __ATOMIC_SEQ_CST)
+#define STORE_SEQ(ptr, val) __atomic_store_n(ptr, val, __ATOMIC_SEQ_CST)
+#define CLAIM_SEQ(ptr, expected, desired) __atomic_compare_exchange_n(ptr, expected, desired, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)
+
+typedef struct wsdeque_ring {
+	size_t capacity;
+	void **els;
+	struct wsdeque_ring *retired;	/* ring this one replaced, kept for thieves that may still read it */
+} wsdeque_ring;
+
+/*
+ * Indices are signed and run freely, only masked to address the ring. The owner briefly moves the bottom
+ * below the top when popping from an empty deque, which is why they can't be unsigned.
+ */
+struct wsdeque_ds {
+	/* thieves write the top and the owner writes the bottom, so each has its own cache line */
+	union wsdeque_padded_index {
+		ptrdiff_t index;
+		char padding[CACHE_LINE];
+	} top, bottom;
+	wsdeque_ring *ring;
+	ds_allocator allocator;
+};
+
+static wsdeque_ring *wsdeque_alloc_ring(wsdeque_ds *const this, size_t capacity) {
+	wsdeque_ring *ring = ds_alloc(&this->allocator, sizeof *ring);
+	DS_ASSERT(ring != NULL, "failed to allocate memory for a " DS_NAME "'s ring");
+	ring->els = ds_alloc(&this->allocator, capacity * sizeof *ring->els);
+	DS_ASSERT(ring->els != NULL, "failed to allocate memory for a " DS_NAME "'s ring");
+	ring->capacity = capacity;
+	ring->retired = NULL;
+	return ring;
+}
+
+wsdeque_ds *alloc_wsdeque(void) {
+	return alloc_wsdeque_with(NULL);
+}
+
+wsdeque_ds *alloc_wsdeque_with(const ds_allocator *allocator) {
+	wsdeque_ds *this;
+	if (allocator == NULL) allocator = &ds_default_allocator;
+	
+	this = ds_alloc(allocator, sizeof *this);
+	DS_ASSERT(this != NULL, "failed to allocate memory for new " DS_NAME);
+	
+	this->allocator = *allocator;
+	this->top.index = 0;
+	this->bottom.index = 0;
+	this->ring = wsdeque_alloc_ring(this, INITIAL_CAPACITY);
+	return this;
+}
+
+void dealloc_wsdeque(wsdeque_ds *const this) {
+	wsdeque_ring *ring = this->ring;
+	while (ring != NULL) {
+		wsdeque_ring *retired = ring->retired;
+		ds_free(&this->allocator, ring->els, ring->capacity * sizeof *ring->els);
+		ds_free(&this->allocator, ring, sizeof *ring);
+		ring = retired;
+	}
+	ds_free(&this->allocator, this, sizeof *this);
+}
+
+/* doubles the ring, copying the elements from top to bottom over to the same indices of the new one */
+static wsdeque_ring *wsdeque_grow(wsdeque_ds *const this, wsdeque_ring *ring, ptrdiff_t top, ptrdiff_t bottom) {
+	wsdeque_ring *grown = wsdeque_alloc_ring(this, ring->capacity << 1);
+	ptrdiff_t i;
+	
+	for (i = top; i < bottom; i++) {
+		grown->els[(size_t)i & (grown->capacity - 1)] = LOAD(&ring->els[(size_t)i & (ring->capacity - 1)]);
+	}
+	grown->retired = ring;
+	STORE_RELEASE(&this->ring, grown);
+	return grown;
+}
+
+void wsdeque_push(wsdeque_ds *const this, void *el) {
+	ptrdiff_t bottom = LOAD(&this->bottom.index);
+	ptrdiff_t top = LOAD_ACQUIRE(&this->top.index);
+	wsdeque_ring *ring = LOAD(&this->ring);
+	
+	if ((size_t)(bottom - top) >= ring->capacity) ring = wsdeque_grow(this, ring, top, bottom);
+	
+	STORE(&ring->els[(size_t)bottom & (ring->capacity - 1)], el);
+	STORE_RELEASE(&this->bottom.index, bottom + 1);
+}
+
+void *wsdeque_pop(wsdeque_ds *const this) {
+	ptrdiff_t bottom = LOAD(&this->bottom.index) - 1;
+	wsdeque_ring *ring = LOAD(&this->ring);
+	ptrdiff_t top;
+	void *el;
+	
+	/* reserve the bottom element before looking at the top, so that thieves stop short of it */
+	STORE_SEQ(&this->bottom.index, bottom);
+	top = LOAD_SEQ(&this->top.index);
+	
+	if (top > bottom) {
+		STORE(&this->bottom.index, bottom + 1);
+		return NULL;
+	}
+	
+	el = LOAD(&ring->els[(size_t)bottom & (ring->capacity - 1)]);
+	if (top == bottom) {
+		/* the last element, thieves may be after it too */
+		if (!CLAIM_SEQ(&this->top.index, &top, top + 1)) el = NULL;
+		STORE(&this->bottom.index, bottom + 1);
+	}
+	return el;
+}
+
+void *wsdeque_steal(wsdeque_ds *const this) {
+	ptrdiff_t top = LOAD_SEQ(&this->top.index);
+	ptrdiff_t bottom = LOAD_SEQ(&this->bottom.index);
+	wsdeque_ring *ring;
+	void *el;
+	
+	if (top >= bottom) return NULL;
+	
+	ring = LOAD_ACQUIRE(&this->ring);
+	el = LOAD(&ring->els[(size_t)top & (ring->capacity - 1)]);
+	if (!CLAIM_SEQ(&this->top.index, &top, top + 1)) return NULL;
+	return el;
+}
+
+size_t wsdeque_size(wsdeque_ds *const this) {
+	ptrdiff_t top = LOAD(&this->top.index);
+	ptrdiff_t bottom = LOAD(&this->bottom.index);
+	return bottom > top ? (size_t)(bottom - top) : 0;
+}
@@ -0,0 +1,80 @@
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "ds_hash.h"
+#include "taskpool.h"
+
+#define LEAVES 4096
+#define GRAIN 1024
+#define ROUNDS 16
+#define MAX_THREADS 64
+
+/* partial sums per worker, a cache line apart so that workers don't contend over them */
+size_t partial[MAX_THREADS][8];
+
+void sum_leaf(size_t leaf, size_t *sum) {
+	size_t i;
+	for (i = leaf * GRAIN; i < (leaf + 1) * GRAIN; i++) {
+		*sum += ds_hash_word(i, 0) >> 8;
+	}
+}
+
+/* node k of the complete binary tree over the leaves spawns its two children, leaves k - LEAVES do the work */
+void sum_node(taskpool_ds *pool, void *arg) {
+	size_t node = (size_t)arg;
+	if (node >= LEAVES) {
+		sum_leaf(node - LEAVES, &partial[taskpool_worker(pool)][0]);
+		return;
+	}
+	taskpool_spawn(pool, sum_node, (void*)(2 * node));
+	taskpool_spawn(pool, sum_node, (void*)(2 * node + 1));
+}
+
+double elapsed(struct timespec *start) {
+	struct timespec end;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (end.tv_sec - start->tv_sec) * 1e3 + (end.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+int main(int argc, char **argv) {
+	int i, threads, max_threads = argc > 1 ? atoi(argv[1]) : 8;
+	size_t leaf, expected = 0;
+	struct timespec start;
+	if (max_threads > MAX_THREADS) max_threads = MAX_THREADS;
+	
+	printf("=== BENCHMARKING TASK POOL === \n");
+	printf("%d rounds summing %d leaves of %d hashes, fanned out recursively from a single task\n", ROUNDS, LEAVES, GRAIN);
+	
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < ROUNDS; i++) {
+		for (leaf = 0; leaf < LEAVES; leaf++) {
+			sum_leaf(leaf, &expected);
+		}
+	}
+	printf("sequential:\t%.2f ms\n", elapsed(&start));
+	
+	printf("threads\ttaskpool (ms)\n");
+	for (threads = 1; threads <= max_threads; threads <<= 1) {
+		taskpool_ds *pool = alloc_taskpool(threads);
+		size_t sum = 0;
+		
+		for (i = 0; i < threads; i++) {
+			partial[i][0] = 0;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (i = 0; i < ROUNDS; i++) {
+			taskpool_spawn(pool, sum_node, (void*)1);
+			taskpool_wait(pool);
+		}
+		printf("%d\t%.2f\n", threads, elapsed(&start));
+		
+		for (i = 0; i < threads; i++) {
+			sum += partial[i][0];
+		}
+		if (sum != expected) printf("tasks were lost or run twice!\n");
+		dealloc_taskpool(pool);
+	}
+	printf("=== BENCHMARKING DONE  === \n");
+	return 0;
+}